@@ -1,7 +1,1370 @@
+/*
+ * csim.c - A cache simulator that replays a valgrind lackey memory
+ *     trace against a hierarchy of up to three set-associative caches
+ *     and counts the hits, misses and evictions.
+ *
+ *     usage: csim [-hv] -s <s> -E <E> -b <b> [-L <s>,<E>,<b>[,<incl>]]
+ *                 [-p <policy>] [-T <threads>] -t <tracefile>
+ *
+ *     L1 has 2^s sets of E lines of 2^b bytes. Each -L adds the next
+ *     level (L2, then L3) with its own geometry. A level is inclusive
+ *     (the default), and holds every block held above it, or exclusive,
+ *     and holds none of them. With L1 alone the output, including the -v
+ *     trace of each access, matches that of csim-ref; with more levels
+ *     the hits, misses, evictions and writebacks of each level follow.
+ *
+ *     The lines of all sets live in one array, set after set, so a
+ *     lookup touches a single contiguous run of E lines. Empty lines are
+ *     always filled first; when a set is full, the replacement policy
+ *     picks the victim. The policy is LRU unless -p names another one
+ *     from the policies table; each is a policy_t of hooks that the
+ *     simulator calls on hits and fills and to pick a victim.
+ *     Instruction loads (I) are ignored, a modify (M) is a load followed
+ *     by a store to the same address, and every access is assumed to
+ *     lie within a single block.
+ *
+ *     With -T, the sets are shared out among threads that simulate their
+ *     own accesses in parallel (see replay_parallel).
+ *
+ *     The trace is read as a stream, through a fixed buffer, so it may
+ *     be a FIFO or stdin (-t -) and as large as it likes; only opt,
+ *     which reads it twice, needs a file and memory for every access.
+ *     It may also be a binary one written by test-trans -n (see
+ *     memtrace.h), which is always replayed by one thread.
+ *
+ *     Stores (S and M) dirty the L1 line, and an evicted dirty line is
+ *     written back into the next level that holds its block, or to
+ *     memory. A block evicted from an inclusive level is removed from
+ *     the levels above it, and a block evicted from the level above an
+ *     exclusive level moves down into it.
+ */
+#define _POSIX_C_SOURCE 200809L  /* for pthread barriers under -std=c99 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include "cachelab.h"
+#include "memtrace.h"
 
-int main()
+#define TRACEBUF (1 << 18)    /* bytes of trace buffered by replay */
+#define CHUNK    (1 << 24)    /* bytes of trace per round of -T */
+
+#define MAXLEVELS 3           /* L1, L2 and L3 */
+
+/*
+ * A trace being read, from a file, a FIFO or stdin. Whatever its size,
+ * it is read through a buffer of TRACEBUF bytes.
+ */
+typedef struct {
+    int fd;
+    int binary;               /* a binary trace from test-trans -n */
+    int eof;                  /* there is nothing more to read */
+    char *buf;                /* TRACEBUF bytes, then a '\n' sentinel */
+    size_t pos, len;          /* the unread bytes are buf[pos..len) */
+} trace_t;
+
+/* One cache line. Only the block matters, since no data is simulated. */
+typedef struct {
+    unsigned long long blk;   /* block number, the address >> b */
+    unsigned long long meta;  /* replacement state, kept by the policy */
+    int valid;                /* holds a block */
+    int dirty;                /* stored to since it was filled */
+} line_t;
+
+typedef struct policy policy_t;
+
+/* One level of the simulated cache hierarchy */
+typedef struct {
+    int s, E, b;              /* set bits, lines per set, block bits */
+    int exclusive;            /* holds no block the level above holds */
+    unsigned long long sets;  /* number of sets, 2^s */
+    line_t *lines;            /* sets * E lines, set after set */
+    const policy_t *policy;   /* the replacement policy */
+    void *state;              /* the policy's own state, if any */
+    unsigned long long hits, misses, evictions, writebacks;
+} cache_t;
+
+/*
+ * A replacement policy. The simulator fills empty lines by itself and
+ * only asks the policy for a victim when the set is full. The policy
+ * keeps its state in the meta word of each line and in c->state.
+ */
+struct policy {
+    char *name;
+    int (*init)(cache_t *c, trace_t *t); /* 0 if c or trace t won't do */
+    void (*hit)(cache_t *c, unsigned long long set, int way);
+    void (*insert)(cache_t *c, unsigned long long set, int way);
+    int (*victim)(cache_t *c, unsigned long long set);
+};
+
+/* The possible outcomes of one access to a level */
+#define HIT      0
+#define MISS     1
+#define EVICTION 2            /* a miss that had to evict a line */
+
+/* Globals set on the command line */
+static int verbose = 0;
+
+/*
+ * The hierarchy, L1 first, and the number of accesses so far. Every
+ * thread of -T has its own copy, with its own counters, of a hierarchy
+ * whose lines all threads share.
+ */
+static __thread cache_t level[MAXLEVELS];
+static int nlevels = 1;
+static __thread unsigned long long clock_now = 0;
+
+/* The state of the random policies' xorshift sequence, one per thread */
+#define RANDOM_SEED 0x9e3779b97f4a7c15ULL
+static __thread unsigned long long random_state = RANDOM_SEED;
+
+/* One access of the trace, queued for the thread that owns its sets */
+typedef struct {
+    unsigned long long addr;
+    unsigned int k;           /* position in its segment of the round */
+    int write;
+} access_t;
+
+/* A growable queue of accesses */
+typedef struct {
+    access_t *a;
+    unsigned int n, max;
+} queue_t;
+
+/*
+ * The state shared by the threads of -T. Each round, the main thread
+ * hands the workers a chunk of whole trace lines, cut into one segment
+ * per worker. Worker w parses segment w into queue[w][t] for each
+ * thread t, then simulates every access queued for it, in trace order.
+ */
+static struct {
+    int nthreads;
+    int shift;                /* the thread of addr is */
+    unsigned long long mask;  /*   ((addr >> shift) & mask) % nthreads */
+    char *buf;                /* the chunk */
+    size_t *seg;              /* segment w is buf[seg[w]..seg[w+1]) */
+    unsigned int *count;      /* the number of accesses in each segment */
+    unsigned long long base;  /* the number of accesses before the round */
+    queue_t *queue;           /* queue[w * nthreads + t] */
+    int done;                 /* no more rounds */
+    pthread_barrier_t round;  /* the main thread and the workers */
+    pthread_barrier_t parsed; /* just the workers */
+} par;
+
+/* What a worker starts from and leaves its counts in */
+typedef struct {
+    int id;
+    cache_t level[MAXLEVELS];
+} worker_t;
+
+/* Function prototypes */
+static void cache_init(cache_t *c, int s, int E, int b);
+static void cache_free(cache_t *c);
+static line_t *cache_find(cache_t *c, unsigned long long addr);
+static void cache_hit(cache_t *c, unsigned long long addr, line_t *line);
+static void cache_fill(int i, unsigned long long addr, int dirty);
+static void evict(int i, unsigned long long addr, int dirty);
+static int invalidate_above(int i, unsigned long long addr);
+static void write_back(int i, unsigned long long addr);
+static void access_block(unsigned long long addr, int write, int *outcome);
+static void replay(trace_t *t);
+static void replay_parallel(trace_t *trace, int nthreads);
+static void *worker(void *vargp);
+static void parse_segment(int w);
+static size_t read_chunk(char *buf, size_t *carry, trace_t *t);
+static void print_outcome(int *outcome);
+static void print_summary(void);
+static int parse_level(char *arg, cache_t *c);
+static int parse_line(char *buf, char *op, unsigned long long *addr,
+                      unsigned int *size, char **nl);
+static int trace_open(trace_t *t, char *path);
+static void trace_close(trace_t *t);
+static size_t trace_fill(trace_t *t, size_t need);
+static size_t trace_read(trace_t *t, char *dst, size_t n);
+static int trace_rewind(trace_t *t);
+static int next_access(trace_t *t, char *op, unsigned long long *addr,
+                       unsigned int *size);
+static void usage(char *argv0);
+
+/* Replacement policy functions */
+static int no_init(cache_t *c, trace_t *t);
+static void no_update(cache_t *c, unsigned long long set, int way);
+static void stamp_line(cache_t *c, unsigned long long set, int way);
+static int oldest_line(cache_t *c, unsigned long long set);
+static int random_line(cache_t *c, unsigned long long set);
+static int plru_init(cache_t *c, trace_t *t);
+static void plru_update(cache_t *c, unsigned long long set, int way);
+static int plru_victim(cache_t *c, unsigned long long set);
+static void rrip_hit(cache_t *c, unsigned long long set, int way);
+static void srrip_insert(cache_t *c, unsigned long long set, int way);
+static void brrip_insert(cache_t *c, unsigned long long set, int way);
+static int rrip_victim(cache_t *c, unsigned long long set);
+static int opt_init(cache_t *c, trace_t *t);
+static void opt_update(cache_t *c, unsigned long long set, int way);
+static int opt_victim(cache_t *c, unsigned long long set);
+
+/* The replacement policies, selected with -p. The first is the default. */
+static const policy_t policies[] = {
+    /* name      init       hit           insert        victim */
+    {"lru",      no_init,   stamp_line,   stamp_line,   oldest_line},
+    {"fifo",     no_init,   no_update,    stamp_line,   oldest_line},
+    {"random",   no_init,   no_update,    no_update,    random_line},
+    {"plru",     plru_init, plru_update,  plru_update,  plru_victim},
+    {"srrip",    no_init,   rrip_hit,     srrip_insert, rrip_victim},
+    {"brrip",    no_init,   rrip_hit,     brrip_insert, rrip_victim},
+    {"opt",      opt_init,  opt_update,   opt_update,   opt_victim},
+};
+static const int npolicies = sizeof(policies) / sizeof(policies[0]);
+
+int main(int argc, char **argv)
 {
-    printSummary(0, 0, 0);
+    int s = -1, E = -1, b = -1;
+    char *tracefile = NULL;
+    const policy_t *policy = &policies[0];
+    int nthreads = 1;
+    trace_t trace;
+    int c, i;
+
+    while ((c = getopt(argc, argv, "hvs:E:b:t:L:p:T:")) != -1) {
+        switch (c) {
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        case 'v':
+            verbose = 1;
+            break;
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 't':
+            tracefile = optarg;
+            break;
+        case 'L':
+            if (nlevels == MAXLEVELS) {
+                printf("%s: At most %d cache levels\n", argv[0], MAXLEVELS);
+                exit(1);
+            }
+            if (!parse_level(optarg, &level[nlevels])) {
+                printf("%s: Bad cache level -L %s\n", argv[0], optarg);
+                usage(argv[0]);
+                exit(1);
+            }
+            nlevels++;
+            break;
+        case 'p':
+            for (i = 0; i < npolicies; i++)
+                if (strcmp(optarg, policies[i].name) == 0)
+                    break;
+            if (i == npolicies) {
+                printf("%s: Unknown replacement policy %s\n", argv[0], optarg);
+                usage(argv[0]);
+                exit(1);
+            }
+            policy = &policies[i];
+            break;
+        case 'T':
+            nthreads = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (s < 0 || E <= 0 || b < 0 || s + b >= 64 || tracefile == NULL) {
+        printf("%s: Missing required command line argument\n", argv[0]);
+        usage(argv[0]);
+        exit(1);
+    }
+    if (nthreads < 1 || (nthreads > 1 && verbose)) {
+        printf("%s: -T needs a positive count, and no -v\n", argv[0]);
+        exit(1);
+    }
+
+    /*
+     * A block of a level must hold whole blocks of the level above, and
+     * a block that moves into an exclusive level must fit it exactly.
+     */
+    level[0].b = b;
+    for (i = 1; i < nlevels; i++) {
+        if (level[i].b < level[i-1].b ||
+            (level[i].exclusive && level[i].b != level[i-1].b)) {
+            printf("%s: L%d blocks must be %s the L%d blocks\n", argv[0],
+                   i + 1, level[i].exclusive ? "as large as" :
+                   "at least as large as", i);
+            exit(1);
+        }
+    }
+
+    if (!trace_open(&trace, tracefile)) {
+        fprintf(stderr, "%s: %s\n", tracefile, strerror(errno));
+        exit(1);
+    }
+
+    cache_init(&level[0], s, E, b);
+    for (i = 1; i < nlevels; i++)
+        cache_init(&level[i], level[i].s, level[i].E, level[i].b);
+    for (i = 0; i < nlevels; i++) {
+        level[i].policy = policy;
+        if (!policy->init(&level[i], &trace))
+            exit(1);
+    }
+    if (nthreads > 1 && !trace.binary)
+        replay_parallel(&trace, nthreads);
+    else
+        replay(&trace);
+    trace_close(&trace);
+
+    print_summary();
+    if (nlevels > 1) {
+        for (i = 0; i < nlevels; i++)
+            printf("L%d hits:%llu misses:%llu evictions:%llu "
+                   "writebacks:%llu\n", i + 1, level[i].hits,
+                   level[i].misses, level[i].evictions, level[i].writebacks);
+    }
+    for (i = 0; i < nlevels; i++)
+        cache_free(&level[i]);
     return 0;
 }
+
+/*
+ * cache_init - Make c an empty cache of 2^s sets of E lines of 2^b bytes
+ */
+static void cache_init(cache_t *c, int s, int E, int b)
+{
+    c->s = s;
+    c->E = E;
+    c->b = b;
+    c->sets = 1ULL << s;
+    c->lines = calloc(c->sets * E, sizeof(line_t));
+    if (c->lines == NULL) {
+        fprintf(stderr, "Not enough memory for a cache of %llu lines\n",
+                c->sets * E);
+        exit(1);
+    }
+    c->hits = c->misses = c->evictions = c->writebacks = 0;
+}
+
+/*
+ * cache_free - Free the lines of cache c
+ */
+static void cache_free(cache_t *c)
+{
+    free(c->lines);
+    free(c->state);
+    c->lines = NULL;
+    c->state = NULL;
+}
+
+/*
+ * cache_find - Return the line of c that holds the block of addr, or
+ *     NULL if c does not hold it
+ */
+static line_t *cache_find(cache_t *c, unsigned long long addr)
+{
+    unsigned long long blk = addr >> c->b;
+    line_t *line = &c->lines[(blk & (c->sets - 1)) * c->E];
+    int i;
+
+    for (i = 0; i < c->E; i++)
+        if (line[i].valid && line[i].blk == blk)
+            return &line[i];
+    return NULL;
+}
+
+/*
+ * cache_hit - Tell the policy of c that line, which holds the block of
+ *     addr, was just used
+ */
+static void cache_hit(cache_t *c, unsigned long long addr, line_t *line)
+{
+    unsigned long long set = (addr >> c->b) & (c->sets - 1);
+
+    c->policy->hit(c, set, line - &c->lines[set * c->E]);
+}
+
+/*
+ * cache_fill - Bring the block of addr into level i, which must not
+ *     hold it. It goes into the first empty line of its set or, if the
+ *     set is full, replaces the line the policy picks.
+ */
+static void cache_fill(int i, unsigned long long addr, int dirty)
+{
+    cache_t *c = &level[i];
+    unsigned long long blk = addr >> c->b;
+    unsigned long long set = blk & (c->sets - 1);
+    line_t *victim = &c->lines[set * c->E];
+    unsigned long long vblk;
+    int j, vdirty, evicted;
+
+    for (j = 0; j < c->E && victim[j].valid; j++)
+        ;
+    if (j == c->E)
+        j = c->policy->victim(c, set);
+    victim += j;
+
+    evicted = victim->valid;
+    vblk = victim->blk;
+    vdirty = victim->dirty;
+    victim->blk = blk;
+    victim->valid = 1;
+    victim->dirty = dirty;
+    c->policy->insert(c, set, j);
+
+    /* Only now that the line is refilled can its old block move down */
+    if (evicted) {
+        c->evictions++;
+        evict(i, vblk << c->b, vdirty);
+    }
+}
+
+/*
+ * evict - Deal with the block of addr leaving level i. An inclusive
+ *     level first takes the block out of the levels above it. The block
+ *     then moves into the level below if that level is exclusive, and
+ *     otherwise is written back if it is dirty.
+ */
+static void evict(int i, unsigned long long addr, int dirty)
+{
+    line_t *line;
+
+    if (i > 0 && !level[i].exclusive)
+        dirty |= invalidate_above(i, addr);
+    if (dirty)
+        level[i].writebacks++;
+
+    if (i + 1 < nlevels && level[i+1].exclusive) {
+        if ((line = cache_find(&level[i+1], addr)) != NULL)
+            line->dirty |= dirty;
+        else
+            cache_fill(i + 1, addr, dirty);
+    }
+    else if (dirty)
+        write_back(i + 1, addr);
+}
+
+/*
+ * invalidate_above - Remove every part of the level i block of addr
+ *     from the levels above i. Returns 1 if any of the parts was dirty.
+ */
+static int invalidate_above(int i, unsigned long long addr)
+{
+    unsigned long long a, start, end;
+    line_t *line;
+    int k, dirty = 0;
+
+    start = addr & ~((1ULL << level[i].b) - 1);
+    end = start + (1ULL << level[i].b);
+    for (k = 0; k < i; k++) {
+        for (a = start; a < end; a += 1ULL << level[k].b) {
+            if ((line = cache_find(&level[k], a)) != NULL) {
+                dirty |= line->dirty;
+                line->valid = 0;
+                line->dirty = 0;
+            }
+        }
+    }
+    return dirty;
+}
+
+/*
+ * write_back - Mark the block of addr dirty in the first level from i
+ *     down that holds it. Past the last level it goes to memory.
+ */
+static void write_back(int i, unsigned long long addr)
+{
+    line_t *line;
+
+    for (; i < nlevels; i++) {
+        if ((line = cache_find(&level[i], addr)) != NULL) {
+            line->dirty = 1;
+            return;
+        }
+    }
+}
+
+/*
+ * access_block - Load (or, if write is set, store to) the block holding
+ *     addr. The levels are searched from L1 down to the first that holds
+ *     the block, and the block is then filled into every level above
+ *     that one except the exclusive ones. A hit in an exclusive level
+ *     moves the block up rather than copying it. Stores only dirty L1.
+ *     Unless outcome is NULL, outcome[i] is set to the outcome at level
+ *     i, or -1 if the access did not reach level i. The caller advances
+ *     clock_now.
+ */
+static void access_block(unsigned long long addr, int write, int *outcome)
+{
+    unsigned long long evictions[MAXLEVELS];
+    line_t *line = NULL;
+    int h, i, dirty = 0;
+
+    if (outcome != NULL) {
+        for (i = 0; i < nlevels; i++) {
+            evictions[i] = level[i].evictions;
+            outcome[i] = -1;
+        }
+    }
+
+    for (h = 0; h < nlevels; h++) {
+        if ((line = cache_find(&level[h], addr)) != NULL)
+            break;
+        level[h].misses++;
+    }
+    if (h < nlevels) {
+        level[h].hits++;
+        if (h > 0 && level[h].exclusive) {
+            dirty = line->dirty;
+            line->valid = 0;
+            line->dirty = 0;
+        }
+        else {
+            cache_hit(&level[h], addr, line);
+            if (h == 0)
+                line->dirty |= write;
+        }
+    }
+
+    /* Fill from the bottom up, so that no fill can undo one above it */
+    for (i = h - 1; i >= 0; i--) {
+        if (i > 0 && level[i].exclusive)
+            continue;
+        cache_fill(i, addr, dirty | (i == 0 ? write : 0));
+        dirty = 0;
+    }
+
+    for (i = 0; outcome != NULL && i < nlevels && i <= h; i++) {
+        if (i == h)
+            outcome[i] = HIT;
+        else
+            outcome[i] = level[i].evictions != evictions[i] ? EVICTION : MISS;
+    }
+}
+
+/*
+ * replay - Run every data access in trace t through the hierarchy
+ */
+static void replay(trace_t *t)
+{
+    int outcome[MAXLEVELS];
+    unsigned long long addr;
+    unsigned int size;
+    char op;
+
+    while (next_access(t, &op, &addr, &size)) {
+        if (verbose)
+            printf("%c %llx,%u ", op, addr, size);
+        clock_now++;
+        access_block(addr, op == 'S', verbose ? outcome : NULL);
+        if (verbose)
+            print_outcome(outcome);
+        if (op == 'M') {
+            clock_now++;
+            access_block(addr, 1, verbose ? outcome : NULL); /* a hit */
+            if (verbose)
+                print_outcome(outcome);
+        }
+        if (verbose)
+            printf("\n");
+    }
+}
+
+/*
+ * replay_parallel - Run the trace through the hierarchy with nthreads
+ *     threads, each of which owns a share of the sets of every level.
+ *
+ *     A block's sets at every level are picked by its address bits just
+ *     above the largest block offset, so these bits also pick its
+ *     thread, and no two threads ever touch the same set. Each access
+ *     keeps its place in the whole trace, which is what the policies
+ *     see as the time, so the counts are those of replay, except with
+ *     the random policies. There can be no more threads than there are
+ *     values of the bits shared by the set indexes of all levels, and
+ *     if they share none, the trace is replayed by one thread.
+ *
+ *     The main thread reads the next chunk while the workers parse and
+ *     simulate the current one.
+ */
+static void replay_parallel(trace_t *trace, int nthreads)
+{
+    char *buf[2];
+    worker_t *result;
+    pthread_t *tid;
+    size_t len, next, carry = 0;
+    int bits = 64, cur = 0, i, t;
+
+    par.shift = 0;
+    for (i = 0; i < nlevels; i++)
+        if (level[i].b > par.shift)
+            par.shift = level[i].b;
+    for (i = 0; i < nlevels; i++)
+        if (level[i].s + level[i].b - par.shift < bits)
+            bits = level[i].s + level[i].b - par.shift;
+    if (bits > 0 && bits < 31 && nthreads > (1 << bits))
+        nthreads = 1 << bits;
+    if (bits <= 0 || nthreads == 1) {
+        replay(trace);
+        return;
+    }
+    par.nthreads = nthreads;
+    par.mask = bits < 64 ? (1ULL << bits) - 1 : ~0ULL;
+
+    buf[0] = malloc(CHUNK + 1);
+    buf[1] = malloc(CHUNK + 1);
+    par.seg = malloc((nthreads + 1) * sizeof(size_t));
+    par.count = calloc(nthreads, sizeof(unsigned int));
+    par.queue = calloc(nthreads * nthreads, sizeof(queue_t));
+    result = malloc(nthreads * sizeof(worker_t));
+    tid = malloc(nthreads * sizeof(pthread_t));
+    if (!buf[0] || !buf[1] || !par.seg || !par.count || !par.queue ||
+        !result || !tid) {
+        fprintf(stderr, "Not enough memory for %d threads\n", nthreads);
+        exit(1);
+    }
+
+    /* Every worker starts from a copy of the hierarchy, minus the counts */
+    pthread_barrier_init(&par.round, NULL, nthreads + 1);
+    pthread_barrier_init(&par.parsed, NULL, nthreads);
+    for (t = 0; t < nthreads; t++) {
+        result[t].id = t;
+        memcpy(result[t].level, level, sizeof(level));
+        for (i = 0; i < nlevels; i++)
+            result[t].level[i].hits = result[t].level[i].misses =
+                result[t].level[i].evictions =
+                result[t].level[i].writebacks = 0;
+        if (pthread_create(&tid[t], NULL, worker, &result[t]) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            exit(1);
+        }
+    }
+
+    len = read_chunk(buf[cur], &carry, trace);
+    for (;;) {
+        /* Cut the chunk into segments of whole lines */
+        par.buf = buf[cur];
+        par.seg[0] = 0;
+        for (t = 1; t < nthreads; t++) {
+            next = (size_t)((double)len * t / nthreads);
+            if (next < par.seg[t-1])
+                next = par.seg[t-1];
+            while (next < len && next > 0 && buf[cur][next - 1] != '\n')
+                next++;
+            par.seg[t] = next;
+        }
+        par.seg[nthreads] = len;
+        par.done = (len == 0);
+
+        pthread_barrier_wait(&par.round);
+        if (par.done)
+            break;
+        memcpy(buf[!cur], buf[cur] + len, carry);
+        next = read_chunk(buf[!cur], &carry, trace);
+        pthread_barrier_wait(&par.round);
+
+        for (t = 0; t < nthreads; t++)
+            par.base += par.count[t];
+        cur = !cur;
+        len = next;
+    }
+
+    for (t = 0; t < nthreads; t++) {
+        pthread_join(tid[t], NULL);
+        for (i = 0; i < nlevels; i++) {
+            level[i].hits += result[t].level[i].hits;
+            level[i].misses += result[t].level[i].misses;
+            level[i].evictions += result[t].level[i].evictions;
+            level[i].writebacks += result[t].level[i].writebacks;
+        }
+    }
+    for (i = 0; i < nthreads * nthreads; i++)
+        free(par.queue[i].a);
+    pthread_barrier_destroy(&par.round);
+    pthread_barrier_destroy(&par.parsed);
+    free(buf[0]);
+    free(buf[1]);
+    free(par.seg);
+    free(par.count);
+    free(par.queue);
+    free(result);
+    free(tid);
+}
+
+/*
+ * worker - The body of a -T thread, whose worker_t is vargp
+ */
+static void *worker(void *vargp)
+{
+    worker_t *self = vargp;
+    int n = par.nthreads, w = self->id;
+    unsigned long long base;
+    queue_t *q;
+    unsigned int i;
+    int v;
+
+    memcpy(level, self->level, sizeof(level));
+    random_state = RANDOM_SEED ^ (w * 0xbf58476d1ce4e5b9ULL);
+    for (;;) {
+        pthread_barrier_wait(&par.round);
+        if (par.done)
+            break;
+        parse_segment(w);
+        pthread_barrier_wait(&par.parsed);
+
+        /* Segment v holds the accesses that follow those of v - 1 */
+        base = par.base;
+        for (v = 0; v < n; v++) {
+            q = &par.queue[v * n + w];
+            for (i = 0; i < q->n; i++) {
+                clock_now = base + q->a[i].k + 1;
+                access_block(q->a[i].addr, q->a[i].write, NULL);
+            }
+            base += par.count[v];
+        }
+        pthread_barrier_wait(&par.round);
+    }
+    memcpy(self->level, level, sizeof(level));
+    return NULL;
+}
+
+/*
+ * parse_segment - Queue each access of segment w for its thread
+ */
+static void parse_segment(int w)
+{
+    char *p = par.buf + par.seg[w], *end = par.buf + par.seg[w+1], *nl;
+    int n = par.nthreads;
+    unsigned long long addr;
+    unsigned int size, k = 0;
+    queue_t *q;
+    int t, m;
+    char op;
+
+    for (t = 0; t < n; t++)
+        par.queue[w * n + t].n = 0;
+    for (; p < end; p = nl + 1) {
+        if (!parse_line(p, &op, &addr, &size, &nl) || op == 'I')
+            continue;
+        q = &par.queue[w * n + ((addr >> par.shift) & par.mask) % n];
+        for (m = 0; m < (op == 'M' ? 2 : 1); m++) {
+            if (q->n == q->max) {
+                q->max = q->max ? 2 * q->max : 1024;
+                if ((q->a = realloc(q->a, q->max * sizeof(access_t))) == NULL) {
+                    fprintf(stderr, "Not enough memory for a queue\n");
+                    exit(1);
+                }
+            }
+            q->a[q->n].addr = addr;
+            q->a[q->n].k = k++;
+            q->a[q->n].write = (op == 'S' || m == 1);
+            q->n++;
+        }
+    }
+    par.count[w] = k;
+}
+
+/*
+ * read_chunk - Fill buf, whose first *carry bytes are already read,
+ *     from trace t. Returns the length of the whole lines at the start of
+ *     buf and sets *carry to the length of the partial line after them.
+ *     The last line of the trace gets a newline if it has none.
+ */
+static size_t read_chunk(char *buf, size_t *carry, trace_t *t)
+{
+    size_t n = *carry + trace_read(t, buf + *carry, CHUNK - *carry);
+    size_t len = n;
+
+    *carry = 0;
+    if (n == CHUNK) {
+        while (len > 0 && buf[len - 1] != '\n')
+            len--;
+        if (len > 0) {
+            *carry = n - len;
+            return len;
+        }
+        len = n;                    /* a line longer than a chunk */
+    }
+    if (n > 0 && buf[n - 1] != '\n')
+        buf[len++] = '\n';
+    return len;
+}
+
+/*
+ * print_outcome - Print the outcome of one access at each level it
+ *     reached. With a single level this is the csim-ref output.
+ */
+static void print_outcome(int *outcome)
+{
+    static char *name[] = {"hit ", "miss ", "miss eviction "};
+    int i;
+
+    for (i = 0; i < nlevels && outcome[i] >= 0; i++) {
+        if (nlevels > 1)
+            printf("L%d ", i + 1);
+        printf("%s", name[outcome[i]]);
+    }
+}
+
+/*
+ * print_summary - Print the counts of L1 with printSummary, which also
+ *     records them for the autograder. printSummary takes ints, so
+ *     counts past INT_MAX, from traces of billions of accesses, are
+ *     printed in the same format here and not recorded.
+ */
+static void print_summary(void)
+{
+    cache_t *c = &level[0];
+
+    if (c->hits <= INT_MAX && c->misses <= INT_MAX && c->evictions <= INT_MAX)
+        printSummary(c->hits, c->misses, c->evictions);
+    else
+        printf("hits:%llu misses:%llu evictions:%llu\n",
+               c->hits, c->misses, c->evictions);
+}
+
+/*
+ * parse_level - Parse the -L argument "s,E,b[,inclusive|exclusive]"
+ *     into cache level c. Returns 0 if it is malformed.
+ */
+static int parse_level(char *arg, cache_t *c)
+{
+    char *p;
+
+    c->s = strtol(arg, &p, 10);
+    if (p == arg || *p++ != ',')
+        return 0;
+    c->E = strtol(arg = p, &p, 10);
+    if (p == arg || *p++ != ',')
+        return 0;
+    c->b = strtol(arg = p, &p, 10);
+    if (p == arg)
+        return 0;
+    c->exclusive = 0;
+    if (*p == ',') {
+        if (strcmp(p + 1, "exclusive") == 0)
+            c->exclusive = 1;
+        else if (strcmp(p + 1, "inclusive") != 0)
+            return 0;
+    }
+    else if (*p != '\0')
+        return 0;
+    return c->s >= 0 && c->E > 0 && c->b >= 0 && c->s + c->b < 64;
+}
+
+/*
+ * parse_line - Parse a trace line of the form "[ ]op addr,size" into
+ *     its parts, and point *nl at the newline that ends it. Returns 0 if
+ *     the line is not an access. The digits are converted by hand, as
+ *     strtoull costs more than the rest of the simulation.
+ */
+static int parse_line(char *buf, char *op, unsigned long long *addr,
+                      unsigned int *size, char **nl)
+{
+    /* The value of each hex digit, plus one */
+    static const unsigned char hex[256] = {
+        ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+        ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+        ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15,
+        ['f'] = 16, ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14,
+        ['E'] = 15, ['F'] = 16,
+    };
+    char *p = buf;
+    unsigned long long a = 0;
+    unsigned int n = 0, d;
+    int ok = 0;
+
+    while (*p == ' ')
+        p++;
+    if (*p != 'L' && *p != 'S' && *p != 'M' && *p != 'I')
+        goto done;
+    *op = *p++;
+    while (*p == ' ')
+        p++;
+    for (buf = p; (d = hex[(unsigned char)*p]) != 0; p++)
+        a = a << 4 | (d - 1);
+    if (p == buf || *p != ',')
+        goto done;
+    for (p++; (d = *p - '0') < 10; p++)
+        n = 10 * n + d;
+    *addr = a;
+    *size = n;
+    ok = 1;
+ done:
+    while (*p != '\n')
+        p++;
+    *nl = p;
+    return ok;
+}
+
+/*
+ * trace_open - Open the trace at path, or stdin if path is "-", and
+ *     tell a binary trace from a text one by its first bytes. Returns 0
+ *     and sets errno if the trace cannot be opened.
+ */
+static int trace_open(trace_t *t, char *path)
+{
+    if (strcmp(path, "-") == 0)
+        t->fd = STDIN_FILENO;
+    else if ((t->fd = open(path, O_RDONLY)) < 0)
+        return 0;
+    if ((t->buf = malloc(TRACEBUF + 1)) == NULL) {
+        fprintf(stderr, "Not enough memory for the trace buffer\n");
+        exit(1);
+    }
+    t->pos = t->len = 0;
+    t->eof = 0;
+    trace_fill(t, MEMTRACE_MAGIC_LEN);
+    t->binary = (t->len >= MEMTRACE_MAGIC_LEN &&
+                 memcmp(t->buf, MEMTRACE_MAGIC, MEMTRACE_MAGIC_LEN) == 0);
+    if (t->binary)
+        t->pos = MEMTRACE_MAGIC_LEN;
+    return 1;
+}
+
+/*
+ * trace_close - Close trace t
+ */
+static void trace_close(trace_t *t)
+{
+    if (t->fd != STDIN_FILENO)
+        close(t->fd);
+    free(t->buf);
+    t->buf = NULL;
+}
+
+/*
+ * trace_fill - Move the unread bytes of t to the start of its buffer
+ *     and read until there are at least need of them, the buffer is
+ *     full or the trace ends. Returns the number of unread bytes.
+ */
+static size_t trace_fill(trace_t *t, size_t need)
+{
+    ssize_t n;
+
+    if (t->pos > 0) {
+        memmove(t->buf, t->buf + t->pos, t->len - t->pos);
+        t->len -= t->pos;
+        t->pos = 0;
+    }
+    while (t->len < need && t->len < TRACEBUF && !t->eof) {
+        if ((n = read(t->fd, t->buf + t->len, TRACEBUF - t->len)) < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Reading the trace: %s\n", strerror(errno));
+            exit(1);
+        }
+        if (n == 0)
+            t->eof = 1;
+        t->len += n;
+    }
+    t->buf[t->len] = '\n';
+    return t->len;
+}
+
+/*
+ * trace_read - Read up to n bytes of t into dst, the buffered ones
+ *     first. Returns fewer than n only at the end of the trace.
+ */
+static size_t trace_read(trace_t *t, char *dst, size_t n)
+{
+    size_t got = t->len - t->pos;
+    ssize_t r;
+
+    if (got > n)
+        got = n;
+    memcpy(dst, t->buf + t->pos, got);
+    t->pos += got;
+    while (got < n && !t->eof) {
+        if ((r = read(t->fd, dst + got, n - got)) < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Reading the trace: %s\n", strerror(errno));
+            exit(1);
+        }
+        if (r == 0)
+            t->eof = 1;
+        got += r;
+    }
+    return got;
+}
+
+/*
+ * trace_rewind - Go back to the first access of t. Returns 0 if t is a
+ *     pipe, which can only be read once.
+ */
+static int trace_rewind(trace_t *t)
+{
+    if (lseek(t->fd, 0, SEEK_SET) < 0)
+        return 0;
+    t->pos = t->len = 0;
+    t->eof = 0;
+    if (t->binary) {
+        trace_fill(t, MEMTRACE_MAGIC_LEN);
+        t->pos = MEMTRACE_MAGIC_LEN;
+    }
+    return 1;
+}
+
+/*
+ * next_access - Read the next data access of trace t, skipping
+ *     instruction loads. Returns 0 at the end of the trace.
+ *
+ *     The sentinel after the buffered bytes ends the last line, which
+ *     is parsed again once the rest of it has been read. A line longer
+ *     than the whole buffer is skipped.
+ */
+static int next_access(trace_t *t, char *op, unsigned long long *addr,
+                       unsigned int *size)
+{
+    memtrace_rec_t rec;
+    char *nl;
+    int ok;
+
+    if (t->binary) {
+        if (t->len - t->pos < sizeof(rec) && trace_fill(t, sizeof(rec)) < sizeof(rec))
+            return 0;
+        memcpy(&rec, t->buf + t->pos, sizeof(rec));
+        t->pos += sizeof(rec);
+        *op = rec.op;
+        *addr = rec.addr;
+        *size = rec.size;
+        return 1;
+    }
+
+    for (;;) {
+        ok = parse_line(t->buf + t->pos, op, addr, size, &nl);
+        if (nl == t->buf + t->len) {
+            if (!t->eof) {
+                if (t->pos == 0 && t->len == TRACEBUF)
+                    t->pos = t->len;         /* drop an overlong line */
+                trace_fill(t, t->len - t->pos + 1);
+                continue;
+            }
+            if (t->pos == t->len)
+                return 0;
+            t->pos = t->len;
+        }
+        else
+            t->pos = nl - t->buf + 1;
+        if (ok && *op != 'I')
+            return 1;
+    }
+}
+
+/*
+ * usage - Print the command line arguments
+ */
+static void usage(char *argv0)
+{
+    printf("Usage: %s [-hv] -s <num> -E <num> -b <num> [-L <spec>] "
+           "[-T <num>] [-p <name>] -t <file>\n", argv0);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -v         Optional verbose flag.\n");
+    printf("  -s <num>   Number of set index bits.\n");
+    printf("  -E <num>   Number of lines per set.\n");
+    printf("  -b <num>   Number of block offset bits.\n");
+    printf("  -L <spec>  Add a cache level: <s>,<E>,<b>[,inclusive|exclusive].\n");
+    printf("  -T <num>   Simulate with <num> threads, each owning some sets.\n");
+    printf("  -p <name>  Replacement policy: lru (default), fifo, random, plru,\n");
+    printf("             srrip, brrip or opt.\n");
+    printf("  -t <file>  Trace file, or - for stdin.\n");
+    printf("\nExamples:\n");
+    printf("  linux>  %s -s 4 -E 1 -b 4 -t traces/yi.trace\n", argv0);
+    printf("  linux>  %s -v -s 8 -E 2 -b 4 -t traces/yi.trace\n", argv0);
+    printf("  linux>  %s -s 4 -E 2 -b 4 -L 6,4,4 -L 8,8,6 -t traces/long.trace\n",
+           argv0);
+}
+
+/*
+ * Replacement policies
+ *
+ * lru and fifo stamp a line with the time of its last use or of its
+ * fill, and replace the oldest line. random replaces a pseudo-random
+ * line, the same on every run. plru is tree pseudo-LRU: the E - 1 bits
+ * of a set form a binary tree whose bits point away from the most
+ * recently used half. srrip and brrip predict when each line will be
+ * used again with a 2-bit re-reference value and replace a line
+ * predicted for the distant future. opt is Belady's algorithm: it
+ * replaces the line whose block is used again furthest in the future,
+ * which it looks up in an index of the whole trace built beforehand.
+ */
+
+/*
+ * no_init, no_update - For policies without state or updates
+ */
+static int no_init(cache_t *c, trace_t *t)
+{
+    return 1;
+}
+
+static void no_update(cache_t *c, unsigned long long set, int way)
+{
+}
+
+/*
+ * stamp_line - Record the current time in the line
+ */
+static void stamp_line(cache_t *c, unsigned long long set, int way)
+{
+    c->lines[set * c->E + way].meta = clock_now;
+}
+
+/*
+ * oldest_line - Return the line with the oldest time
+ */
+static int oldest_line(cache_t *c, unsigned long long set)
+{
+    line_t *line = &c->lines[set * c->E];
+    int i, victim = 0;
+
+    for (i = 1; i < c->E; i++)
+        if (line[i].meta < line[victim].meta)
+            victim = i;
+    return victim;
+}
+
+/*
+ * random_next - Return the next number of this thread's xorshift sequence
+ */
+static unsigned long long random_next(void)
+{
+    unsigned long long x = random_state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    random_state = x;
+    return x;
+}
+
+/*
+ * random_line - Return any line
+ */
+static int random_line(cache_t *c, unsigned long long set)
+{
+    return random_next() % c->E;
+}
+
+/*
+ * plru_init - Give every set a tree of E - 1 bits. Node n of the tree
+ *     is bit n of the set's word, and its children are nodes 2n and
+ *     2n + 1; the E lines are the leaves E to 2E - 1.
+ */
+static int plru_init(cache_t *c, trace_t *t)
+{
+    if ((c->E & (c->E - 1)) != 0 || c->E > 64) {
+        printf("plru needs a power of two of at most 64 lines per set\n");
+        return 0;
+    }
+    c->state = calloc(c->sets, sizeof(unsigned long long));
+    if (c->state == NULL) {
+        fprintf(stderr, "Not enough memory for the plru trees\n");
+        exit(1);
+    }
+    return 1;
+}
+
+/*
+ * plru_update - Point every node on the path to the line at its sibling
+ */
+static void plru_update(cache_t *c, unsigned long long set, int way)
+{
+    unsigned long long *tree = &((unsigned long long *)c->state)[set];
+    int n;
+
+    for (n = c->E + way; n > 1; n /= 2) {
+        if (n & 1)
+            *tree &= ~(1ULL << (n / 2));
+        else
+            *tree |= 1ULL << (n / 2);
+    }
+}
+
+/*
+ * plru_victim - Follow the bits from the root down to a line
+ */
+static int plru_victim(cache_t *c, unsigned long long set)
+{
+    unsigned long long tree = ((unsigned long long *)c->state)[set];
+    int n = 1;
+
+    while (n < c->E)
+        n = 2 * n + ((tree >> n) & 1);
+    return n - c->E;
+}
+
+#define RRPV_MAX 3            /* re-reference in the distant future */
+
+/*
+ * rrip_hit - A line that was used is predicted to be used again soon
+ */
+static void rrip_hit(cache_t *c, unsigned long long set, int way)
+{
+    c->lines[set * c->E + way].meta = 0;
+}
+
+/*
+ * srrip_insert - A new line is predicted to be used again in a while
+ */
+static void srrip_insert(cache_t *c, unsigned long long set, int way)
+{
+    c->lines[set * c->E + way].meta = RRPV_MAX - 1;
+}
+
+/*
+ * brrip_insert - Mostly predict the distant future for a new line, so
+ *     that a scan larger than the cache does not flush it
+ */
+static void brrip_insert(cache_t *c, unsigned long long set, int way)
+{
+    c->lines[set * c->E + way].meta =
+        random_next() % 32 == 0 ? RRPV_MAX - 1 : RRPV_MAX;
+}
+
+/*
+ * rrip_victim - Return the first line predicted for the distant future,
+ *     aging the whole set until there is one
+ */
+static int rrip_victim(cache_t *c, unsigned long long set)
+{
+    line_t *line = &c->lines[set * c->E];
+    int i;
+
+    for (;;) {
+        for (i = 0; i < c->E; i++)
+            if (line[i].meta >= RRPV_MAX)
+                return i;
+        for (i = 0; i < c->E; i++)
+            line[i].meta++;
+    }
+}
+
+/* One use of a block in the trace, at time k */
+typedef struct {
+    unsigned long long blk, k;
+} use_t;
+
+static unsigned long long *opt_addr;  /* the address of access k, from 1 */
+static unsigned long long opt_n;      /* the number of accesses */
+
+/*
+ * use_cmp - Order uses by block, then by time
+ */
+static int use_cmp(const void *a, const void *b)
+{
+    const use_t *x = a, *y = b;
+
+    if (x->blk != y->blk)
+        return x->blk < y->blk ? -1 : 1;
+    return x->k < y->k ? -1 : x->k > y->k;
+}
+
+/*
+ * opt_init - Read trace t, then rewind it, and index every use
+ *     of every block of c by block and time. The meta word of a line is
+ *     the position in the index of the line's next known use.
+ */
+static int opt_init(cache_t *c, trace_t *t)
+{
+    unsigned long long addr, k, max = 0;
+    unsigned int size;
+    use_t *use;
+    char op;
+
+    if (opt_addr == NULL) {
+        if (lseek(t->fd, 0, SEEK_CUR) < 0) {
+            printf("opt needs to read the trace twice, so not from a pipe\n");
+            return 0;
+        }
+        while (next_access(t, &op, &addr, &size)) {
+            if (opt_n + 2 >= max) {
+                max = max ? 2 * max : 4096;
+                if ((opt_addr = realloc(opt_addr, max * sizeof(addr))) == NULL) {
+                    fprintf(stderr, "Not enough memory for the trace\n");
+                    exit(1);
+                }
+            }
+            opt_addr[++opt_n] = addr;
+            if (op == 'M')
+                opt_addr[++opt_n] = addr;
+        }
+        trace_rewind(t);
+    }
+
+    if ((use = malloc((opt_n + 1) * sizeof(use_t))) == NULL) {
+        fprintf(stderr, "Not enough memory for the opt index\n");
+        exit(1);
+    }
+    for (k = 1; k <= opt_n; k++) {
+        use[k - 1].blk = opt_addr[k] >> c->b;
+        use[k - 1].k = k;
+    }
+    qsort(use, opt_n, sizeof(use_t), use_cmp);
+    c->state = use;
+    return 1;
+}
+
+/*
+ * opt_next - Return the time of the next use of the line's block after
+ *     now, or ~0 if there is none, moving its meta word forward
+ */
+static unsigned long long opt_next(cache_t *c, line_t *line)
+{
+    use_t *use = c->state;
+    unsigned long long p = line->meta;
+
+    while (p < opt_n && use[p].blk == line->blk && use[p].k <= clock_now)
+        p++;
+    line->meta = p;
+    return (p < opt_n && use[p].blk == line->blk) ? use[p].k : ~0ULL;
+}
+
+/*
+ * opt_update - Find the first use of the line's block after now. The
+ *     block need not be the one accessed now: an exclusive level is
+ *     filled with the blocks evicted above it.
+ */
+static void opt_update(cache_t *c, unsigned long long set, int way)
+{
+    line_t *line = &c->lines[set * c->E + way];
+    use_t *use = c->state;
+    unsigned long long lo = 0, hi = opt_n, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (use[mid].blk < line->blk ||
+            (use[mid].blk == line->blk && use[mid].k <= clock_now))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    line->meta = lo;
+}
+
+/*
+ * opt_victim - Return the line used again furthest in the future
+ */
+static int opt_victim(cache_t *c, unsigned long long set)
+{
+    line_t *line = &c->lines[set * c->E];
+    unsigned long long next, furthest = 0;
+    int i, victim = 0;
+
+    for (i = 0; i < c->E; i++) {
+        if ((next = opt_next(c, &line[i])) > furthest) {
+            furthest = next;
+            victim = i;
+        }
+    }
+    return victim;
+}
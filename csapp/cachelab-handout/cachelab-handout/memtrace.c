@@ -0,0 +1,165 @@
+/*
+ * memtrace.c - The hooks that trans-trace.o calls on every load and
+ *     store, and the cache model they feed (see memtrace.h).
+ *
+ *     gcc's -fsanitize=thread instrumentation calls __tsan_readN(addr)
+ *     before a load of N bytes and __tsan_writeN(addr) before a store.
+ *     Only the hooks that trans.c code can reach are defined; the rest
+ *     of the ThreadSanitizer interface does nothing here.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memtrace.h"
+
+/* The watched ranges, and where the accesses go while tracing */
+static unsigned long long lo[MEMTRACE_RANGES];
+static unsigned long long len[MEMTRACE_RANGES];
+static int nranges = 0;
+static int tracing = 0;
+static memtrace_cache_t *cache = NULL;
+static FILE *trace_fp = NULL;
+
+/*
+ * memtrace_cache_init - Make c an empty cache of 2^s sets of E lines
+ */
+void memtrace_cache_init(memtrace_cache_t *c, int s, int E, int b)
+{
+    c->s = s;
+    c->E = E;
+    c->b = b;
+    c->tag = calloc((1ULL << s) * E, sizeof(unsigned long long));
+    c->stamp = calloc((1ULL << s) * E, sizeof(unsigned long long));
+    if (c->tag == NULL || c->stamp == NULL) {
+        fprintf(stderr, "Not enough memory for the cache model\n");
+        exit(1);
+    }
+    c->clock = 0;
+    c->hits = c->misses = c->evictions = 0;
+}
+
+/*
+ * memtrace_cache_free - Free the lines of cache c
+ */
+void memtrace_cache_free(memtrace_cache_t *c)
+{
+    free(c->tag);
+    free(c->stamp);
+    c->tag = c->stamp = NULL;
+}
+
+/*
+ * cache_access - Access the block holding addr in cache c
+ */
+static void cache_access(memtrace_cache_t *c, unsigned long long addr)
+{
+    unsigned long long set = (addr >> c->b) & ((1ULL << c->s) - 1);
+    unsigned long long tag = addr >> (c->s + c->b);
+    unsigned long long *t = &c->tag[set * c->E];
+    unsigned long long *stamp = &c->stamp[set * c->E];
+    int i, victim = 0;
+
+    c->clock++;
+    for (i = 0; i < c->E; i++) {
+        if (stamp[i] != 0 && t[i] == tag) {
+            stamp[i] = c->clock;
+            c->hits++;
+            return;
+        }
+        if (stamp[i] < stamp[victim])
+            victim = i;
+    }
+    c->misses++;
+    if (stamp[victim] != 0)
+        c->evictions++;
+    t[victim] = tag;
+    stamp[victim] = c->clock;
+}
+
+/*
+ * memtrace_watch - Record the accesses to the len bytes at p
+ */
+void memtrace_watch(const void *p, unsigned long n)
+{
+    if (nranges == MEMTRACE_RANGES) {
+        fprintf(stderr, "memtrace: at most %d ranges\n", MEMTRACE_RANGES);
+        exit(1);
+    }
+    lo[nranges] = (unsigned long long)p;
+    len[nranges] = n;
+    nranges++;
+}
+
+/*
+ * memtrace_start - Send the recorded accesses to cache c and trace fp
+ */
+void memtrace_start(memtrace_cache_t *c, FILE *fp)
+{
+    cache = c;
+    trace_fp = fp;
+    tracing = 1;
+}
+
+/*
+ * memtrace_stop - Stop recording
+ */
+void memtrace_stop(void)
+{
+    tracing = 0;
+    cache = NULL;
+    trace_fp = NULL;
+}
+
+/*
+ * record - Count one access of size bytes at p, if it is watched
+ */
+static void record(void *p, unsigned int size, unsigned int op)
+{
+    unsigned long long addr = (unsigned long long)p;
+    memtrace_rec_t rec;
+    int i;
+
+    if (!tracing)
+        return;
+    for (i = 0; i < nranges; i++)
+        if (addr - lo[i] < len[i])
+            break;
+    if (i == nranges)
+        return;
+
+    if (cache != NULL)
+        cache_access(cache, addr);
+    if (trace_fp != NULL) {
+        rec.addr = addr;
+        rec.size = size;
+        rec.op = op;
+        fwrite(&rec, sizeof(rec), 1, trace_fp);
+    }
+}
+
+/*
+ * The ThreadSanitizer hooks
+ */
+void __tsan_init(void) {}
+void __tsan_func_entry(void *pc) {}
+void __tsan_func_exit(void) {}
+
+void __tsan_read1(void *p) { record(p, 1, 'L'); }
+void __tsan_read2(void *p) { record(p, 2, 'L'); }
+void __tsan_read4(void *p) { record(p, 4, 'L'); }
+void __tsan_read8(void *p) { record(p, 8, 'L'); }
+void __tsan_read16(void *p) { record(p, 16, 'L'); }
+void __tsan_write1(void *p) { record(p, 1, 'S'); }
+void __tsan_write2(void *p) { record(p, 2, 'S'); }
+void __tsan_write4(void *p) { record(p, 4, 'S'); }
+void __tsan_write8(void *p) { record(p, 8, 'S'); }
+void __tsan_write16(void *p) { record(p, 16, 'S'); }
+
+void __tsan_unaligned_read2(void *p) { record(p, 2, 'L'); }
+void __tsan_unaligned_read4(void *p) { record(p, 4, 'L'); }
+void __tsan_unaligned_read8(void *p) { record(p, 8, 'L'); }
+void __tsan_unaligned_read16(void *p) { record(p, 16, 'L'); }
+void __tsan_unaligned_write2(void *p) { record(p, 2, 'S'); }
+void __tsan_unaligned_write4(void *p) { record(p, 4, 'S'); }
+void __tsan_unaligned_write8(void *p) { record(p, 8, 'S'); }
+void __tsan_unaligned_write16(void *p) { record(p, 16, 'S'); }
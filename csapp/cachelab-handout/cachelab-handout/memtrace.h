@@ -0,0 +1,53 @@
+/*
+ * memtrace.h - In-process memory tracing of the transpose functions
+ *
+ * trans-trace.o is trans.c compiled with -fsanitize=thread, which has
+ * gcc call a hook before every load and store the code makes. Instead
+ * of the ThreadSanitizer runtime, test-trans links memtrace.c, whose
+ * hooks record the accesses that fall in the watched ranges (A and B)
+ * while tracing is on. The accesses go straight into an LRU cache model
+ * and, optionally, into a binary trace that csim can replay, so no
+ * valgrind run and no text trace are needed.
+ */
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+#include <stdio.h>
+
+/* A binary trace is the magic string followed by one record per access */
+#define MEMTRACE_MAGIC "MEMTRC1\n"
+#define MEMTRACE_MAGIC_LEN 8
+
+typedef struct {
+    unsigned long long addr;
+    unsigned int size;
+    unsigned int op;          /* 'L' or 'S' */
+} memtrace_rec_t;
+
+/* The most ranges that can be watched at once */
+#define MEMTRACE_RANGES 4
+
+/* An LRU cache of 2^s sets of E lines of 2^b bytes, counted like csim-ref */
+typedef struct {
+    int s, E, b;
+    unsigned long long *tag;  /* 2^s * E tags, set after set */
+    unsigned long long *stamp; /* time of last use, 0 if empty */
+    unsigned long long clock;
+    unsigned int hits, misses, evictions;
+} memtrace_cache_t;
+
+/* Make c an empty cache, or free its lines */
+void memtrace_cache_init(memtrace_cache_t *c, int s, int E, int b);
+void memtrace_cache_free(memtrace_cache_t *c);
+
+/* Record accesses to the len bytes at p (up to MEMTRACE_RANGES ranges) */
+void memtrace_watch(const void *p, unsigned long len);
+
+/*
+ * Start sending every recorded access to cache c and writing it to the
+ * binary trace fp, either of which may be NULL; or stop.
+ */
+void memtrace_start(memtrace_cache_t *c, FILE *fp);
+void memtrace_stop(void);
+
+#endif /* MEMTRACE_H */
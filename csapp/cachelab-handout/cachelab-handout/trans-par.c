@@ -0,0 +1,158 @@
+/*
+ * trans-par.c - A multithreaded transpose for large matrices.
+ *
+ *     The rows of A are cut into bands of TRANS_BAND rows, one row of
+ *     64x64 blocks of tiles each, and the threads of a pool take bands
+ *     from a shared counter until none is left. A band writes its own
+ *     columns of B, so threads seldom write the same line of B, and
+ *     taking bands one at a time keeps the threads busy to the end
+ *     whatever the shape. The last band holds the rows past the last
+ *     whole tile, which the row kernels copy one int at a time.
+ *
+ *     The workers sleep on a condition variable between calls, so that a
+ *     call costs one wakeup rather than a thread creation per thread.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "transbench.h"
+
+typedef void (*rows_func_t)(int M, int N, int[N][M], int[M][N], int, int);
+
+struct transpool {
+    int nthreads;             /* threads, counting the caller */
+    pthread_t *tid;           /* the nthreads-1 workers */
+    pthread_mutex_t lock;
+    pthread_cond_t start;     /* a new call, or quit */
+    pthread_cond_t done;      /* the last worker finished the call */
+    unsigned long gen;        /* calls so far */
+    int running;              /* workers still on the current call */
+    int quit;
+
+    /* The current call */
+    rows_func_t rows;
+    int M, N;
+    void *A, *B;
+    int next;                 /* the next band to take */
+};
+
+/* Function prototypes */
+static void take_bands(transpool_t *p);
+static void *worker(void *arg);
+
+/*
+ * take_bands - Transpose bands of the current call until none is left
+ */
+static void take_bands(transpool_t *p)
+{
+    int nbands = (p->N + TRANS_BAND - 1) / TRANS_BAND;
+    int band, M = p->M, N = p->N;
+
+    while ((band = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED)) < nbands)
+        p->rows(M, N, p->A, p->B, band * TRANS_BAND, (band + 1) * TRANS_BAND);
+}
+
+/*
+ * worker - Wait for a call, share its bands, and report back
+ */
+static void *worker(void *arg)
+{
+    transpool_t *p = arg;
+    unsigned long seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        while (p->gen == seen && !p->quit)
+            pthread_cond_wait(&p->start, &p->lock);
+        if (p->quit) {
+            pthread_mutex_unlock(&p->lock);
+            return NULL;
+        }
+        seen = p->gen;
+        pthread_mutex_unlock(&p->lock);
+
+        take_bands(p);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->running == 0)
+            pthread_cond_signal(&p->done);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+/*
+ * transpool_create - Start a pool of nthreads threads, counting the
+ *     caller, which use AVX2 if the CPU has it and SSE2 if not
+ */
+transpool_t *transpool_create(int nthreads)
+{
+    transpool_t *p = calloc(1, sizeof(transpool_t));
+    int t;
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (p == NULL || (p->tid = calloc(nthreads, sizeof(pthread_t))) == NULL) {
+        fprintf(stderr, "Not enough memory for the thread pool\n");
+        exit(1);
+    }
+    p->nthreads = nthreads;
+    p->rows = trans_avx2_supported() ? trans_avx2_rows : trans_sse_rows;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    for (t = 0; t < nthreads - 1; t++) {
+        if (pthread_create(&p->tid[t], NULL, worker, p) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            exit(1);
+        }
+    }
+    return p;
+}
+
+/*
+ * transpool_destroy - Stop the workers of pool p and free it
+ */
+void transpool_destroy(transpool_t *p)
+{
+    int t;
+
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+    for (t = 0; t < p->nthreads - 1; t++)
+        pthread_join(p->tid[t], NULL);
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+    free(p->tid);
+    free(p);
+}
+
+/*
+ * trans_parallel - Transpose the N x M matrix A into B with the threads
+ *     of pool p
+ */
+void trans_parallel(transpool_t *p, int M, int N, int A[N][M], int B[M][N])
+{
+    pthread_mutex_lock(&p->lock);
+    p->M = M;
+    p->N = N;
+    p->A = A;
+    p->B = B;
+    p->next = 0;
+    p->running = p->nthreads - 1;
+    p->gen++;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    take_bands(p);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->running > 0)
+        pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
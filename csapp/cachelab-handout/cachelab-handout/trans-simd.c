@@ -0,0 +1,171 @@
+/*
+ * trans-simd.c - Transpose kernels that move 8x8 tiles of ints through
+ *     vector registers: a tile is read as 8 rows, transposed by a
+ *     network of unpack and shuffle instructions, and written as 8 rows
+ *     of B, so neither matrix is ever accessed one int at a time.
+ *
+ *     The tiles are visited in TILE x TILE blocks, so that the rows of
+ *     B a block writes stay cached from one row of tiles to the next.
+ *     Rows and columns past the last whole tile are copied one by one.
+ *
+ *     SSE2 is part of x86-64, but AVX2 is not, so only the AVX2 functions
+ *     are compiled for AVX2, and the rest of the file runs on any x86-64.
+ */
+#include <stddef.h>
+#include <immintrin.h>
+#include "transbench.h"
+
+#define TILE 64               /* ints per side of a block of tiles */
+
+/*
+ * tr4x4_sse - Transpose the 4x4 tile at a, whose rows are lda ints
+ *     apart, into the tile at b, whose rows are ldb ints apart
+ */
+static inline void tr4x4_sse(const int *a, size_t lda, int *b, size_t ldb)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)a);
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(a + lda));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(a + 2 * lda));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(a + 3 * lda));
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);   /* a00 a10 a01 a11 */
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);   /* a20 a30 a21 a31 */
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);   /* a02 a12 a03 a13 */
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);   /* a22 a32 a23 a33 */
+
+    _mm_storeu_si128((__m128i *)b, _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)(b + ldb), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)(b + 2 * ldb), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i *)(b + 3 * ldb), _mm_unpackhi_epi64(t2, t3));
+}
+
+/*
+ * tr8x8_sse - Transpose an 8x8 tile as four 4x4 tiles
+ */
+static inline void tr8x8_sse(const int *a, size_t lda, int *b, size_t ldb)
+{
+    tr4x4_sse(a, lda, b, ldb);
+    tr4x4_sse(a + 4, lda, b + 4 * ldb, ldb);
+    tr4x4_sse(a + 4 * lda, lda, b + 4, ldb);
+    tr4x4_sse(a + 4 * lda + 4, lda, b + 4 * ldb + 4, ldb);
+}
+
+/*
+ * tr8x8_avx2 - Transpose an 8x8 tile with 256-bit registers. The 32 and
+ *     64-bit unpacks transpose the 4x4 tiles within each 128-bit lane,
+ *     and the lane permutes put the 4x4 tiles in place.
+ */
+__attribute__((target("avx2")))
+static inline void tr8x8_avx2(const int *a, size_t lda, int *b, size_t ldb)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)a);
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)(a + lda));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)(a + 2 * lda));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)(a + 3 * lda));
+    __m256i r4 = _mm256_loadu_si256((const __m256i *)(a + 4 * lda));
+    __m256i r5 = _mm256_loadu_si256((const __m256i *)(a + 5 * lda));
+    __m256i r6 = _mm256_loadu_si256((const __m256i *)(a + 6 * lda));
+    __m256i r7 = _mm256_loadu_si256((const __m256i *)(a + 7 * lda));
+    __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+
+    t0 = _mm256_unpacklo_epi32(r0, r1);   /* a00 a10 a01 a11 | a04 ... */
+    t1 = _mm256_unpackhi_epi32(r0, r1);   /* a02 a12 a03 a13 | a06 ... */
+    t2 = _mm256_unpacklo_epi32(r2, r3);
+    t3 = _mm256_unpackhi_epi32(r2, r3);
+    t4 = _mm256_unpacklo_epi32(r4, r5);
+    t5 = _mm256_unpackhi_epi32(r4, r5);
+    t6 = _mm256_unpacklo_epi32(r6, r7);
+    t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    r0 = _mm256_unpacklo_epi64(t0, t2);   /* a00 a10 a20 a30 | a04 ... */
+    r1 = _mm256_unpackhi_epi64(t0, t2);   /* a01 a11 a21 a31 | a05 ... */
+    r2 = _mm256_unpacklo_epi64(t1, t3);
+    r3 = _mm256_unpackhi_epi64(t1, t3);
+    r4 = _mm256_unpacklo_epi64(t4, t6);   /* a40 a50 a60 a70 | a44 ... */
+    r5 = _mm256_unpackhi_epi64(t4, t6);
+    r6 = _mm256_unpacklo_epi64(t5, t7);
+    r7 = _mm256_unpackhi_epi64(t5, t7);
+
+    _mm256_storeu_si256((__m256i *)b, _mm256_permute2x128_si256(r0, r4, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + ldb),
+                        _mm256_permute2x128_si256(r1, r5, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 2 * ldb),
+                        _mm256_permute2x128_si256(r2, r6, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 3 * ldb),
+                        _mm256_permute2x128_si256(r3, r7, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 4 * ldb),
+                        _mm256_permute2x128_si256(r0, r4, 0x31));
+    _mm256_storeu_si256((__m256i *)(b + 5 * ldb),
+                        _mm256_permute2x128_si256(r1, r5, 0x31));
+    _mm256_storeu_si256((__m256i *)(b + 6 * ldb),
+                        _mm256_permute2x128_si256(r2, r6, 0x31));
+    _mm256_storeu_si256((__m256i *)(b + 7 * ldb),
+                        _mm256_permute2x128_si256(r3, r7, 0x31));
+}
+
+/*
+ * trans_tiles - Transpose rows lo to hi-1 of A into B with tr8x8 for
+ *     every whole 8x8 tile, and one int at a time for the rest. lo must
+ *     be a multiple of 8. Being inlined, it is compiled once for each
+ *     tile function, with the call to it inlined too.
+ */
+static inline __attribute__((always_inline))
+void trans_tiles(int M, int N, int A[N][M], int B[M][N], int lo, int hi,
+                 void (*tr8x8)(const int *, size_t, int *, size_t))
+{
+    int m8 = M - M % 8, n8 = N - N % 8;
+    int ii, jj, i, j;
+
+    if (hi > N)
+        hi = N;
+    for (ii = lo; ii < hi && ii < n8; ii += TILE)
+        for (jj = 0; jj < m8; jj += TILE)
+            for (i = ii; i < ii + TILE && i < hi && i < n8; i += 8)
+                for (j = jj; j < jj + TILE && j < m8; j += 8)
+                    tr8x8(&A[i][j], M, &B[j][i], N);
+
+    for (i = lo; i < hi; i++)
+        for (j = (i < n8 ? m8 : 0); j < M; j++)
+            B[j][i] = A[i][j];
+}
+
+/*
+ * trans_sse_rows - Rows lo to hi-1 of A in 8x8 tiles with SSE2
+ */
+void trans_sse_rows(int M, int N, int A[N][M], int B[M][N], int lo, int hi)
+{
+    trans_tiles(M, N, A, B, lo, hi, tr8x8_sse);
+}
+
+/*
+ * trans_avx2_rows - Rows lo to hi-1 of A in 8x8 tiles with AVX2
+ */
+__attribute__((target("avx2")))
+void trans_avx2_rows(int M, int N, int A[N][M], int B[M][N], int lo, int hi)
+{
+    trans_tiles(M, N, A, B, lo, hi, tr8x8_avx2);
+}
+
+/*
+ * trans_sse - 8x8 tiles with SSE2
+ */
+void trans_sse(int M, int N, int A[N][M], int B[M][N])
+{
+    trans_sse_rows(M, N, A, B, 0, N);
+}
+
+/*
+ * trans_avx2 - 8x8 tiles with AVX2
+ */
+void trans_avx2(int M, int N, int A[N][M], int B[M][N])
+{
+    trans_avx2_rows(M, N, A, B, 0, N);
+}
+
+/*
+ * trans_avx2_supported - Return nonzero if the CPU has AVX2
+ */
+int trans_avx2_supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
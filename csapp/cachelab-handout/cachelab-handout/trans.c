@@ -6,11 +6,23 @@
  *
  * A transpose function is evaluated by counting the number of misses
  * on a 1KB direct mapped cache with a block size of 32 bytes.
+ *
+ * Such a block holds 8 ints, and the cache holds 32 blocks, so a row of
+ * a 32 or 64 wide matrix maps to the same sets as the rows 8 or 4 below
+ * it, and B[j][i] maps to the same set as A[i][j] on the diagonal. The
+ * kernels below are the usual answers to this: blocking, reading a row
+ * of a block into locals before any of it is written to B, and using
+ * part of B as a buffer. Every function keeps to at most 12 int locals.
  */ 
 #include <stdio.h>
 #include "cachelab.h"
 
 int is_transpose(int M, int N, int A[N][M], int B[M][N]);
+void trans_reg8(int M, int N, int A[N][M], int B[M][N]);
+void trans_block8x4(int M, int N, int A[N][M], int B[M][N]);
+void trans_block8(int M, int N, int A[N][M], int B[M][N]);
+void trans_block16(int M, int N, int A[N][M], int B[M][N]);
+void trans_recursive(int M, int N, int A[N][M], int B[M][N]);
 
 /* 
  * transpose_submit - This is the solution transpose function that you
@@ -22,6 +34,10 @@ int is_transpose(int M, int N, int A[N][M], int B[M][N]);
 char transpose_submit_desc[] = "Transpose submission";
 void transpose_submit(int M, int N, int A[N][M], int B[M][N])
 {
+    if (M == 64 && N == 64)
+        trans_block8x4(M, N, A, B);
+    else
+        trans_reg8(M, N, A, B);
 }
 
 /* 
@@ -46,6 +62,205 @@ void trans(int M, int N, int A[N][M], int B[M][N])
 
 }
 
+/*
+ * trans_edges - Transpose the part of A outside its top left m x n
+ *     corner, for kernels that only handle whole blocks
+ */
+static void trans_edges(int M, int N, int A[N][M], int B[M][N], int m, int n)
+{
+    int i, j;
+
+    for (i = 0; i < N; i++)
+        for (j = (i < n ? m : 0); j < M; j++)
+            B[j][i] = A[i][j];
+}
+
+/*
+ * trans_reg8 - Register blocking: for each strip of 8 columns of A,
+ *     read the 8 ints of each row of the strip into locals, then write
+ *     them down a column of B. A row of A is read in full before B can
+ *     evict it, even on the diagonal, and the 8 rows of B that the strip
+ *     writes stay cached for 8 rows of A.
+ */
+char trans_reg8_desc[] = "Register-blocked 8-wide strips";
+void trans_reg8(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (j = 0; j + 8 <= M; j += 8) {
+        for (i = 0; i < N; i++) {
+            t0 = A[i][j];
+            t1 = A[i][j+1];
+            t2 = A[i][j+2];
+            t3 = A[i][j+3];
+            t4 = A[i][j+4];
+            t5 = A[i][j+5];
+            t6 = A[i][j+6];
+            t7 = A[i][j+7];
+            B[j][i] = t0;
+            B[j+1][i] = t1;
+            B[j+2][i] = t2;
+            B[j+3][i] = t3;
+            B[j+4][i] = t4;
+            B[j+5][i] = t5;
+            B[j+6][i] = t6;
+            B[j+7][i] = t7;
+        }
+    }
+    trans_edges(M, N, A, B, M - M % 8, N);
+}
+
+/*
+ * trans_block8x4 - 8x8 blocks moved in 4x4 quarters. In a 64 wide
+ *     matrix the lower 4 rows of a block conflict with the upper 4, so
+ *     each block of B is written 4 rows at a time. The top half of the
+ *     block of A goes to the top left of the block of B, transposed, and
+ *     to its top right, which stands in for the bottom left until the
+ *     bottom half of A has been read; then the two are swapped row by
+ *     row, while the diagonal of every 4x4 quarter is read into locals.
+ */
+char trans_block8x4_desc[] = "8x8 blocks in 4x4 quarters";
+void trans_block8x4(int M, int N, int A[N][M], int B[M][N])
+{
+    int ii, jj, k, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (ii = 0; ii + 8 <= N; ii += 8) {
+        for (jj = 0; jj + 8 <= M; jj += 8) {
+            for (k = 0; k < 4; k++) {
+                t0 = A[ii+k][jj];
+                t1 = A[ii+k][jj+1];
+                t2 = A[ii+k][jj+2];
+                t3 = A[ii+k][jj+3];
+                t4 = A[ii+k][jj+4];
+                t5 = A[ii+k][jj+5];
+                t6 = A[ii+k][jj+6];
+                t7 = A[ii+k][jj+7];
+                B[jj][ii+k] = t0;
+                B[jj+1][ii+k] = t1;
+                B[jj+2][ii+k] = t2;
+                B[jj+3][ii+k] = t3;
+                B[jj][ii+k+4] = t4;
+                B[jj+1][ii+k+4] = t5;
+                B[jj+2][ii+k+4] = t6;
+                B[jj+3][ii+k+4] = t7;
+            }
+            for (k = 0; k < 4; k++) {
+                t0 = A[ii+4][jj+k];
+                t1 = A[ii+5][jj+k];
+                t2 = A[ii+6][jj+k];
+                t3 = A[ii+7][jj+k];
+                t4 = B[jj+k][ii+4];
+                t5 = B[jj+k][ii+5];
+                t6 = B[jj+k][ii+6];
+                t7 = B[jj+k][ii+7];
+                B[jj+k][ii+4] = t0;
+                B[jj+k][ii+5] = t1;
+                B[jj+k][ii+6] = t2;
+                B[jj+k][ii+7] = t3;
+                B[jj+k+4][ii] = t4;
+                B[jj+k+4][ii+1] = t5;
+                B[jj+k+4][ii+2] = t6;
+                B[jj+k+4][ii+3] = t7;
+            }
+            for (k = 4; k < 8; k++) {
+                t0 = A[ii+4][jj+k];
+                t1 = A[ii+5][jj+k];
+                t2 = A[ii+6][jj+k];
+                t3 = A[ii+7][jj+k];
+                B[jj+k][ii+4] = t0;
+                B[jj+k][ii+5] = t1;
+                B[jj+k][ii+6] = t2;
+                B[jj+k][ii+7] = t3;
+            }
+        }
+    }
+    trans_edges(M, N, A, B, M - M % 8, N - N % 8);
+}
+
+/*
+ * trans_block - Transpose A in bsize x bsize blocks, row by row within
+ *     a block. On the diagonal of a square block, A[i][i] and B[i][i]
+ *     share a set, so it is copied only after the rest of the row.
+ */
+static void trans_block(int M, int N, int A[N][M], int B[M][N], int bsize)
+{
+    int ii, jj, i, j, diag = 0, tmp = 0;
+
+    for (ii = 0; ii < N; ii += bsize) {
+        for (jj = 0; jj < M; jj += bsize) {
+            for (i = ii; i < ii + bsize && i < N; i++) {
+                for (j = jj; j < jj + bsize && j < M; j++) {
+                    if (i == j) {
+                        diag = i;
+                        tmp = A[i][j];
+                    }
+                    else
+                        B[j][i] = A[i][j];
+                }
+                if (ii == jj && i < M)
+                    B[diag][diag] = tmp;
+            }
+        }
+    }
+}
+
+/*
+ * trans_block8 - 8x8 blocks, one cache block of A per row
+ */
+char trans_block8_desc[] = "8x8 blocks";
+void trans_block8(int M, int N, int A[N][M], int B[M][N])
+{
+    trans_block(M, N, A, B, 8);
+}
+
+/*
+ * trans_block16 - 16x16 blocks, with half as many block edges as 8x8
+ *     but conflicts within a block unless, as in 61x67, the rows of A
+ *     do not map onto the same sets as the rows below them
+ */
+char trans_block16_desc[] = "16x16 blocks";
+void trans_block16(int M, int N, int A[N][M], int B[M][N])
+{
+    trans_block(M, N, A, B, 16);
+}
+
+/*
+ * trans_rec - Transpose rows i0..i1-1 and columns j0..j1-1 of A by
+ *     halving the longer side until the piece is at most 8x8
+ */
+static void trans_rec(int M, int N, int A[N][M], int B[M][N],
+                      int i0, int i1, int j0, int j1)
+{
+    int i, j;
+
+    if (i1 - i0 <= 8 && j1 - j0 <= 8) {
+        for (i = i0; i < i1; i++)
+            for (j = j0; j < j1; j++)
+                B[j][i] = A[i][j];
+    }
+    else if (i1 - i0 >= j1 - j0) {
+        i = i0 + (i1 - i0) / 2;
+        trans_rec(M, N, A, B, i0, i, j0, j1);
+        trans_rec(M, N, A, B, i, i1, j0, j1);
+    }
+    else {
+        j = j0 + (j1 - j0) / 2;
+        trans_rec(M, N, A, B, i0, i1, j0, j);
+        trans_rec(M, N, A, B, i0, i1, j, j1);
+    }
+}
+
+/*
+ * trans_recursive - Cache-oblivious transpose, which never needs to
+ *     know the cache size: the recursion reaches pieces that fit in any
+ *     level of cache on its own
+ */
+char trans_recursive_desc[] = "Recursive cache-oblivious";
+void trans_recursive(int M, int N, int A[N][M], int B[M][N])
+{
+    trans_rec(M, N, A, B, 0, N, 0, M);
+}
+
 /*
  * registerFunctions - This function registers your transpose
  *     functions with the driver.  At runtime, the driver will
@@ -59,6 +274,11 @@ void registerFunctions()
     registerTransFunction(transpose_submit, transpose_submit_desc); 
 
     /* Register any additional transpose functions */
+    registerTransFunction(trans_reg8, trans_reg8_desc);
+    registerTransFunction(trans_block8x4, trans_block8x4_desc);
+    registerTransFunction(trans_block8, trans_block8_desc);
+    registerTransFunction(trans_block16, trans_block16_desc);
+    registerTransFunction(trans_recursive, trans_recursive_desc);
     registerTransFunction(trans, trans_desc); 
 
 }
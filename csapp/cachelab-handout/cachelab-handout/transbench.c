@@ -0,0 +1,272 @@
+/*
+ * transbench.c - Times the transpose kernels natively on large square
+ *     matrices, where the 1 KB cache of the lab is no guide and what
+ *     counts is the time the real machine takes.
+ *
+ *     For each size from 256 up to the largest (or KERNEL_MAX), every
+ *     kernel transposes A into B reps times; the best time is reported,
+ *     along with the bandwidth it stands for (each int of A read and of
+ *     B written once). Then trans_parallel is checked on a few ragged
+ *     shapes and timed the same way from 1K (or the largest, if that
+ *     is smaller) up to the largest, with 1, 2, 4, ... threads.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include "transbench.h"
+
+/* The largest size the single-threaded kernels are timed at */
+#define KERNEL_MAX 8192
+
+/* The smallest size trans_parallel is timed at, unless -n is smaller */
+#define PARALLEL_MIN 1024
+
+/* The kernels that are timed */
+typedef struct {
+    char *name;
+    void (*func)(int M, int N, int[N][M], int[M][N]);
+} kernel_t;
+
+static kernel_t kernels[] = {
+    {"trans", trans},
+    {"trans_reg8", trans_reg8},
+    {"trans_sse", trans_sse},
+    {"trans_avx2", trans_avx2},
+};
+#define NKERNELS (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+/* The shapes, N x M, that trans_parallel must get right */
+static int shapes[][2] = {
+    {67, 61}, {61, 67}, {1, 1000}, {1000, 1}, {1003, 1000}, {1000, 1003},
+};
+#define NSHAPES (int)(sizeof(shapes) / sizeof(shapes[0]))
+
+/* Function prototypes */
+static double now(void);
+static double bench(kernel_t *k, int n, int *A, int *B, int reps);
+static double bench_parallel(transpool_t *pool, int n, int *A, int *B,
+                             int reps);
+static int check(int M, int N, int *A, int *B);
+static void check_parallel(transpool_t *pool);
+static void usage(char *argv[]);
+
+/*
+ * now - The time in seconds, from a monotonic clock
+ */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * bench - Return the best time of reps runs of kernel k on the n x n
+ *     matrix A, or -1 if B was not its transpose
+ */
+static double bench(kernel_t *k, int n, int *A, int *B, int reps)
+{
+    double best = 0, t;
+    int r;
+
+    for (r = 0; r < reps; r++) {
+        memset(B, 0, (size_t)n * n * sizeof(int));
+        t = now();
+        k->func(n, n, (int (*)[n])A, (int (*)[n])B);
+        t = now() - t;
+        if (r == 0 || t < best)
+            best = t;
+    }
+    return check(n, n, A, B) ? best : -1;
+}
+
+/*
+ * bench_parallel - The same as bench, for trans_parallel with pool
+ */
+static double bench_parallel(transpool_t *pool, int n, int *A, int *B,
+                             int reps)
+{
+    double best = 0, t;
+    int r;
+
+    for (r = 0; r < reps; r++) {
+        memset(B, 0, (size_t)n * n * sizeof(int));
+        t = now();
+        trans_parallel(pool, n, n, (int (*)[n])A, (int (*)[n])B);
+        t = now() - t;
+        if (r == 0 || t < best)
+            best = t;
+    }
+    return check(n, n, A, B) ? best : -1;
+}
+
+/*
+ * check - Return 1 if the M x N matrix B is the transpose of A
+ */
+static int check(int M, int N, int *A, int *B)
+{
+    size_t i, j;
+
+    for (i = 0; i < N; i++)
+        for (j = 0; j < M; j++)
+            if (B[j * N + i] != A[i * M + j])
+                return 0;
+    return 1;
+}
+
+/*
+ * check_parallel - Exit unless trans_parallel with pool gets every
+ *     shape in shapes[] right
+ */
+static void check_parallel(transpool_t *pool)
+{
+    int i, j, M, N;
+    int *A, *B;
+
+    for (i = 0; i < NSHAPES; i++) {
+        N = shapes[i][0];
+        M = shapes[i][1];
+        A = malloc((size_t)M * N * sizeof(int));
+        B = calloc((size_t)M * N, sizeof(int));
+        if (A == NULL || B == NULL) {
+            fprintf(stderr, "Not enough memory for %dx%d matrices\n", M, N);
+            exit(1);
+        }
+        for (j = 0; j < M * N; j++)
+            A[j] = j;
+        trans_parallel(pool, M, N, (int (*)[M])A, (int (*)[N])B);
+        if (!check(M, N, A, B)) {
+            printf("Error: trans_parallel is incorrect for M=%d N=%d\n", M, N);
+            exit(1);
+        }
+        free(A);
+        free(B);
+    }
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] [-n <max>] [-r <reps>] [-p <threads>]\n",
+           argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -n <max>    Largest matrix size, a power of 2 (default 8192).\n");
+    printf("  -r <reps>   Runs of each kernel per size (default 3).\n");
+    printf("  -p <threads> Most threads for trans_parallel (default: CPUs).\n");
+    printf("\nExample: %s -n 16384 -r 5 -p 8\n", argv[0]);
+}
+
+/*
+ * main - Main routine
+ */
+int main(int argc, char *argv[])
+{
+    int max = 8192, reps = 3, threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int c, n, i, k, np;
+    int *A, *B, *nthreads;
+    transpool_t **pools;
+    double t, base;
+
+    while ((c = getopt(argc, argv, "hn:r:p:")) != -1) {
+        switch (c) {
+        case 'n':
+            max = atoi(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'p':
+            threads = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (max < 256 || max > 32768 || (max & (max - 1)) != 0 || reps < 1
+        || threads < 1) {
+        printf("Error: bad -n, -r or -p\n");
+        usage(argv);
+        exit(1);
+    }
+
+    A = malloc((size_t)max * max * sizeof(int));
+    B = malloc((size_t)max * max * sizeof(int));
+    if (A == NULL || B == NULL) {
+        fprintf(stderr, "Not enough memory for %dx%d matrices\n", max, max);
+        exit(1);
+    }
+    for (i = 0; i < max * max; i++)
+        A[i] = i;
+
+    printf("%6s  %-12s %10s %8s %8s\n",
+           "size", "kernel", "ms", "GB/s", "speedup");
+    for (n = 256; n <= max && n <= KERNEL_MAX; n *= 2) {
+        base = 0;
+        for (k = 0; k < NKERNELS; k++) {
+            if (kernels[k].func == trans_avx2 && !trans_avx2_supported())
+                continue;
+            t = bench(&kernels[k], n, A, B, reps);
+            if (t < 0) {
+                printf("%6d  %-12s incorrect\n", n, kernels[k].name);
+                continue;
+            }
+            if (k == 0)
+                base = t;
+            printf("%6d  %-12s %10.3f %8.2f %7.2fx\n", n, kernels[k].name,
+                   t * 1e3, 2.0 * n * n * sizeof(int) / t / 1e9,
+                   base > 0 ? base / t : 0);
+        }
+    }
+
+    /* One pool for each thread count: 1, 2, 4, ..., and threads */
+    pools = malloc((threads + 1) * sizeof(transpool_t *));
+    nthreads = malloc((threads + 1) * sizeof(int));
+    if (pools == NULL || nthreads == NULL) {
+        fprintf(stderr, "Not enough memory for the thread pools\n");
+        exit(1);
+    }
+    for (np = 0, i = 1; i < threads; i *= 2)
+        nthreads[np++] = i;
+    nthreads[np++] = threads;
+    for (k = 0; k < np; k++)
+        pools[k] = transpool_create(nthreads[k]);
+    check_parallel(pools[np - 1]);
+
+    printf("\n%6s  %-12s %10s %8s %8s\n",
+           "size", "threads", "ms", "GB/s", "speedup");
+    for (n = max < PARALLEL_MIN ? max : PARALLEL_MIN; n <= max; n *= 2) {
+        base = 0;
+        for (k = 0; k < np; k++) {
+            t = bench_parallel(pools[k], n, A, B, reps);
+            if (t < 0) {
+                printf("%6d  %-12d incorrect\n", n, nthreads[k]);
+                continue;
+            }
+            if (k == 0)
+                base = t;
+            printf("%6d  %-12d %10.3f %8.2f %7.2fx\n", n, nthreads[k],
+                   t * 1e3, 2.0 * n * n * sizeof(int) / t / 1e9,
+                   base > 0 ? base / t : 0);
+        }
+    }
+
+    for (k = 0; k < np; k++)
+        transpool_destroy(pools[k]);
+    free(pools);
+    free(nthreads);
+    free(A);
+    free(B);
+    return 0;
+}
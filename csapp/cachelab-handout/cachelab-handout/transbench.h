@@ -0,0 +1,40 @@
+/*
+ * transbench.h - Transpose kernels for large matrices, which transbench
+ *     times natively rather than on the lab's 1 KB cache model
+ */
+#ifndef TRANSBENCH_H
+#define TRANSBENCH_H
+
+/* The baselines, from trans.c */
+void trans(int M, int N, int A[N][M], int B[M][N]);
+void trans_reg8(int M, int N, int A[N][M], int B[M][N]);
+
+/*
+ * trans-simd.c: 8x8 tiles transposed in registers, with SSE2 as four
+ * 4x4 unpack networks or with AVX2 as one 8x8 network. trans_avx2 may
+ * only be called if trans_avx2_supported() says the CPU has AVX2.
+ */
+void trans_sse(int M, int N, int A[N][M], int B[M][N]);
+void trans_avx2(int M, int N, int A[N][M], int B[M][N]);
+int trans_avx2_supported(void);
+
+/* The same for rows lo to hi-1 of A only; lo must be a multiple of 8 */
+void trans_sse_rows(int M, int N, int A[N][M], int B[M][N], int lo, int hi);
+void trans_avx2_rows(int M, int N, int A[N][M], int B[M][N], int lo, int hi);
+
+/*
+ * trans-par.c: a pool of threads that share out bands of TRANS_BAND rows
+ * of A, one row of 64x64 blocks of tiles each, and transpose them with
+ * the kernels above. The calling thread is one of the nthreads; the pool
+ * is created once and reused by every trans_parallel call.
+ */
+#define TRANS_BAND 64
+
+typedef struct transpool transpool_t;
+
+transpool_t *transpool_create(int nthreads);
+void transpool_destroy(transpool_t *pool);
+void trans_parallel(transpool_t *pool, int M, int N,
+                    int A[N][M], int B[M][N]);
+
+#endif /* TRANSBENCH_H */
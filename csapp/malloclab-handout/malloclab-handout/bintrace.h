@@ -0,0 +1,50 @@
+/*
+ * bintrace.h - Binary trace file format for the malloc lab driver
+ *
+ * A binary trace holds the same information as a .rep text trace in
+ * a form that mdriver can mmap and replay without parsing. The file
+ * is a bintrace_hdr_t followed by num_ops fixed-width op records, all
+ * in the byte order of the machine that wrote the file. Each record
+ * has the same layout as mdriver's traceop_t, so the records are
+ * used in place. rep2bin converts text traces to this format.
+ *
+ * Version 1 records had no align field and no calloc or memalign ops.
+ * mdriver still reads such files, but copies their records.
+ */
+#ifndef __BINTRACE_H_
+#define __BINTRACE_H_
+
+#define BINTRACE_MAGIC   0x52544d4d   /* "MMTR" in a little-endian file */
+#define BINTRACE_VERSION 2
+
+/* Op types, numbered like mdriver's traceop_t */
+#define BINTRACE_ALLOC   0
+#define BINTRACE_FREE    1
+#define BINTRACE_REALLOC 2
+#define BINTRACE_CALLOC  3
+#define BINTRACE_MEMALIGN 4
+
+typedef struct {
+    unsigned int magic;    /* BINTRACE_MAGIC */
+    unsigned int version;  /* BINTRACE_VERSION */
+    int sugg_heapsize;     /* suggested heap size (unused) */
+    int num_ids;           /* number of alloc/realloc ids */
+    int num_ops;           /* number of op records that follow */
+    int weight;            /* weight for this trace (unused) */
+} bintrace_hdr_t;
+
+typedef struct {
+    int type;              /* BINTRACE_ALLOC, _FREE, _REALLOC, ... */
+    int index;             /* block id */
+    int size;              /* byte size of alloc/realloc request */
+    int align;             /* alignment of a memalign request, else 0 */
+} bintrace_op_t;
+
+/* The op record of a version 1 file */
+typedef struct {
+    int type;
+    int index;
+    int size;
+} bintrace_op_v1_t;
+
+#endif /* __BINTRACE_H_ */
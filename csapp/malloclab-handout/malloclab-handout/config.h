@@ -62,6 +62,28 @@
  */
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 
+/*
+ * Set USE_MMAP_HEAP to 1 to model the heap as a MAX_VHEAP-byte mmap
+ * reservation. Its pages are committed as the heap grows, and a
+ * negative mem_sbrk returns them to the kernel. Set it to 0 to model
+ * the heap as a fixed MAX_HEAP block from malloc that never shrinks.
+ */
+#define USE_MMAP_HEAP 1
+#define MAX_VHEAP (1<<30)      /* 1 GB of address space */
+
+/* Largest heap that mem_sbrk will hand out */
+#if USE_MMAP_HEAP
+#define HEAP_LIMIT MAX_VHEAP
+#else
+#define HEAP_LIMIT MAX_HEAP
+#endif
+
+/*
+ * Number of untimed runs of each trace before mdriver -B starts timing,
+ * so that the caches and the simulated heap's pages are warm
+ */
+#define BENCH_WARMUP 3
+
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
  *****************************************************************************/
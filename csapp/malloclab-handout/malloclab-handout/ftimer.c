@@ -7,8 +7,11 @@
  * Function timers that estimate the running time (in seconds) of a function f.
  *    ftimer_itimer: version that uses the interval timer
  *    ftimer_gettod: version that uses gettimeofday
+ *    ftimer_samples: times every run separately with the raw monotonic
+ *                    clock, for computing the spread of the running time
  */
 #include <stdio.h>
+#include <time.h>
 #include <sys/time.h>
 #include "ftimer.h"
 
@@ -52,6 +55,27 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
     return (1E-3*diff);
 }
 
+/* 
+ * ftimer_samples - Run f(argp) warmup times to warm up the caches and 
+ * the heap, then time n more runs one at a time. The seconds used by
+ * each of those runs are stored in secs[0..n-1].
+ */
+void ftimer_samples(ftimer_test_funct f, void *argp, int warmup, int n, 
+		    double *secs)
+{
+    int i;
+    struct timespec sts, ets;
+
+    for (i = 0; i < warmup; i++)
+	f(argp);
+    for (i = 0; i < n; i++) {
+	clock_gettime(FTIMER_CLOCK, &sts);
+	f(argp);
+	clock_gettime(FTIMER_CLOCK, &ets);
+	secs[i] = (ets.tv_sec - sts.tv_sec) + 1E-9*(ets.tv_nsec - sts.tv_nsec);
+    }
+}
+
 
 /*
  * Routines for manipulating the Unix interval timer
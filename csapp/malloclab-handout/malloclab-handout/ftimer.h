@@ -1,8 +1,18 @@
 /* 
  * Function timers 
  */
+#include <time.h>
+
 typedef void (*ftimer_test_funct)(void *); 
 
+/* The clock for clock_gettime timings. The raw clock is not slewed by 
+   NTP, but it is Linux only */
+#ifdef CLOCK_MONOTONIC_RAW
+#define FTIMER_CLOCK CLOCK_MONOTONIC_RAW
+#else
+#define FTIMER_CLOCK CLOCK_MONOTONIC
+#endif
+
 /* Estimate the running time of f(argp) using the Unix interval timer.
    Return the average of n runs */
 double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
@@ -12,3 +22,8 @@ double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
    Return the average of n runs */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n);
 
+/* Time warmup untimed runs of f(argp) and then n timed runs with the
+   raw monotonic clock. Store the seconds of each timed run in secs[] */
+void ftimer_samples(ftimer_test_funct f, void *argp, int warmup, int n, 
+		    double *secs);
+
@@ -7,19 +7,29 @@
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sched.h>
 #include <errno.h>
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <math.h>
 #include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "ftimer.h"
 #include "config.h"
+#include "bintrace.h"
 
 /**********************
  * Constants and macros
@@ -33,22 +43,49 @@
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
 
+/* AA tree level of range tree node t, where an empty tree has level 0 */
+#define LEVEL(t) ((t) == NULL ? 0 : (t)->level)
+
+/* Seconds between two gettimeofday readings */
+#define ELAPSED(stv, etv) (((etv).tv_sec - (stv).tv_sec) + \
+			   1E-6*((etv).tv_usec - (stv).tv_usec))
+
+/* 
+ * Latency histograms keep 2^HIST_SUB_BITS linear buckets for each
+ * power of two, so a bucket is never wider than 1/2^HIST_SUB_BITS of
+ * the values in it. Latencies of 2^HIST_MAX_BITS ns and up share the
+ * last bucket.
+ */
+#define HIST_SUB_BITS  4
+#define HIST_SUB       (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS  40
+#define HIST_BUCKETS   ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+/* Number of request types, and so of -L latency histograms per trace */
+#define NUM_OPTYPES    5
+
+/* The -F profile counts free blocks of 2^4, 2^5, ... 2^20 bytes and up */
+#define LAYOUT_BINS    17
+
 /****************************** 
  * The key compound data types 
  *****************************/
 
-/* Records the extent of each block's payload */
+/* Records the extent of each block's payload, as a node of a range tree */
 typedef struct range_t {
-    char *lo;              /* low payload address */
+    char *lo;              /* low payload address (the key) */
     char *hi;              /* high payload address */
-    struct range_t *next;  /* next list element */
+    struct range_t *left;  /* ranges at lower addresses */
+    struct range_t *right; /* ranges at higher addresses */
+    int level;             /* AA tree level, 1 at the leaves */
 } range_t;
 
 /* Characterizes a single trace operation (allocator request) */
 typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
+    enum {ALLOC, FREE, REALLOC, CALLOC, MEMALIGN} type; /* type of request */
     int index;                        /* index for free() to use later */
     int size;                         /* byte size of alloc/realloc request */
+    int align;                        /* alignment of a memalign request */
 } traceop_t;
 
 /* Holds the information for one trace file*/
@@ -60,8 +97,17 @@ typedef struct {
     traceop_t *ops;      /* array of requests */
     char **blocks;       /* array of ptrs returned by malloc/realloc... */
     size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+    void *map;           /* mapping that ops points into (binary traces) */
+    size_t map_len;      /* length of that mapping */
 } trace_t;
 
+/* Binary trace records are used in place as traceop_t structs */
+typedef char traceop_matches_bintrace[
+    (sizeof(traceop_t) == sizeof(bintrace_op_t) && 
+     ALLOC == BINTRACE_ALLOC && FREE == BINTRACE_FREE && 
+     REALLOC == BINTRACE_REALLOC && CALLOC == BINTRACE_CALLOC &&
+     MEMALIGN == BINTRACE_MEMALIGN) ? 1 : -1];
+
 /* 
  * Holds the params to the xxx_speed functions, which are timed by fcyc. 
  * This struct is necessary because fcyc accepts only a pointer array
@@ -72,6 +118,15 @@ typedef struct {
     range_t *ranges;
 } speed_t;
 
+/* Holds one thread's share of a trace in the multithreaded replay */
+typedef struct {
+    traceop_t *ops;              /* the requests for this thread's ids */
+    int num_ops;                 /* number of requests in ops */
+    char **blocks;               /* shared block array, indexed by id */
+    pthread_barrier_t *start;    /* released once every thread is ready */
+    struct timeval stv, etv;     /* when this thread started and finished */
+} thread_arg_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
     /* defined for both libc malloc and student malloc package (mm.c) */
@@ -79,18 +134,56 @@ typedef struct {
     int valid;       /* was the trace processed correctly by the allocator? */
     double secs;     /* number of secs needed to run the trace */
 
+    double copied;   /* payload bytes moved by realloc to a new address */
+
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    double peak_heap;/* largest heap size while computing util */
+    double peak_rss; /* largest resident heap size while computing util */
+    double check_secs;/* wall-clock secs spent in the correctness check */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
 
+/* Summarizes the repeated timed runs of mm malloc on some trace (-B) */
+typedef struct {
+    double median;   /* Kops/sec of the median run */
+    double p99;      /* Kops/sec of the run slower than 99% of the others */
+    double stddev;   /* standard deviation of the runs' Kops/sec */
+    double min, max; /* slowest and fastest runs' Kops/sec */
+} bench_t;
+
+/* A log-bucketed histogram of the latencies of one type of request (-L) */
+typedef struct {
+    long count[HIST_BUCKETS]; /* number of requests in each bucket */
+    long total;               /* number of requests recorded */
+    long max;                 /* largest latency in ns */
+} hist_t;
+
+/* What one mm_heap_walk found, for the heap layout profile (-F) */
+typedef struct {
+    double alloc;             /* bytes in allocated blocks */
+    double overhead;          /* header and footer bytes of those blocks */
+    double free;              /* bytes in free blocks */
+    double largest;           /* size of the largest free block */
+    int nfree;                /* number of free blocks */
+    int free_sizes[LAYOUT_BINS]; /* free blocks by power-of-two size */
+    double *class_alloc;      /* allocated bytes in each size class */
+    double *class_free;       /* free bytes in each size class */
+} layout_t;
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
+static int jobs = 1;    /* number of traces evaluated at once (-j) */
+static pid_t *workers;  /* pid of the worker process in each -j slot, or 0 */
+static int check_every = 0; /* check the heap this often while validating (-C) */
+static int check_level = 2; /* level passed to mm_checkheap (-C) */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
+static char *op_names[NUM_OPTYPES] = /* request types, as in traceop_t */
+    {"malloc", "free", "realloc", "calloc", "memalign"};
 
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
@@ -105,28 +198,62 @@ static char *default_tracefiles[] = {
  * Function prototypes 
  *********************/
 
-/* these functions manipulate range lists */
+/* these functions manipulate range trees */
 static int add_range(range_t **ranges, char *lo, int size, 
 		     int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
+static range_t *skew(range_t *t);
+static range_t *split(range_t *t);
+static range_t *insert_range(range_t *t, range_t *p);
+static range_t *delete_range(range_t *t, char *lo);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(char *tracedir, char *filename);
+static void map_trace(trace_t *trace, FILE *tracefile, char *path);
+static void copy_v1_ops(trace_t *trace, bintrace_op_v1_t *ops);
 static void free_trace(trace_t *trace);
 
+/* Carry out the malloc, calloc or memalign request op */
+static char *mm_alloc_op(traceop_t *op);
+static char *libc_alloc_op(traceop_t *op);
+
 /* Routines for evaluating the correctness and speed of libc malloc */
-static int eval_libc_valid(trace_t *trace, int tracenum);
+static int eval_libc_valid(trace_t *trace, int tracenum, double *copied);
 static void eval_libc_speed(void *ptr);
 
 /* Routines for evaluating correctnes, space utilization, and speed 
    of the student's malloc package in mm.c */
-static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
+static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges,
+			 double *copied);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_bench(speed_t *params, double ops, int runs, 
+			  bench_t *bench);
+static void eval_mm_latency(trace_t *trace, hist_t *hists);
+static void eval_mm_layout(trace_t *trace, int tracenum, char *filename, 
+			   int every);
+static void layout_block(const mm_block_t *block, void *arg);
+static void write_layout(FILE *fp, int opnum, double payload, layout_t *l);
+static double eval_mm_threads(trace_t *trace, int nthreads);
+static void *replay_thread(void *vargp);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printmemory(int n, stats_t *stats);
+static int cmp_double(const void *a, const void *b);
+static void hist_add(hist_t *hist, long ns);
+static long hist_percentile(hist_t *hist, double q);
+static void printlatency(int n, stats_t *stats, hist_t *hists);
+static int pin_cpu(int slot);
+static void *shared_calloc(size_t nmemb, size_t size);
+static int fork_worker(void);
+static void worker_exit(void);
+static void wait_worker(void);
+static void wait_workers(void);
+static void printbench(int n, stats_t *stats, bench_t *bench);
+static void writejson(char *filename, char **tracefiles, int n, 
+		      stats_t *stats, bench_t *bench, int runs, int cpu);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -143,6 +270,7 @@ int main(int argc, char **argv)
     int num_tracefiles = 0;    /* the number of traces in that array */
     trace_t *trace = NULL;     /* stores a single trace file in memory */
     range_t *ranges = NULL;    /* keeps track of block extents for one trace */
+    struct timeval stv, etv;   /* brackets the correctness check */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
     speed_t speed_params;      /* input parameters to the xx_speed routines */ 
@@ -150,6 +278,17 @@ int main(int argc, char **argv)
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int max_threads = 0; /* If set, replay with up to this many threads (-T) */
+    int nthreads;
+    double base_secs;
+    int bench_runs = 0;  /* If set, time each trace this many times (-B) */
+    char *json_file = NULL; /* If set, write the -B results here (-J) */
+    bench_t *mm_bench = NULL; /* -B results for each trace */
+    int cpu = -1;        /* CPU that -B runs are pinned to, or -1 */
+    int slot;            /* -j slot of this worker process, or -1 */
+    int latency = 0;     /* If set, time every request of each trace (-L) */
+    hist_t *mm_hists = NULL; /* -L histograms, NUM_OPTYPES per trace */
+    int layout_every = 0;/* If set, profile the heap this often (-F) */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -158,7 +297,7 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:T:B:J:F:j:C:hvVgalL")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -184,6 +323,39 @@ int main(int argc, char **argv)
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+	case 'T': /* Replay the traces with up to this many threads */
+	    max_threads = atoi(optarg);
+	    if (max_threads < 1)
+		app_error("The -T thread count must be at least 1");
+	    if (max_threads > 1 && !mm_thread_safe)
+		app_error("This mm package is not thread-safe; use mdriver-mt for -T");
+	    break;
+	case 'B': /* Time each trace this many times and report the spread */
+	    bench_runs = atoi(optarg);
+	    if (bench_runs < 1)
+		app_error("The -B run count must be at least 1");
+	    break;
+	case 'J': /* Also write the -B results as JSON */
+	    json_file = optarg;
+	    break;
+	case 'L': /* Time every request and report the latency percentiles */
+	    latency = 1;
+	    break;
+	case 'j': /* Evaluate this many traces at once in worker processes */
+	    jobs = atoi(optarg);
+	    if (jobs < 1)
+		app_error("The -j job count must be at least 1");
+	    break;
+	case 'C': /* Check the heap every so many requests, at some level */
+	    if (sscanf(optarg, "%d,%d", &check_every, &check_level) < 1 ||
+		check_every < 1)
+		app_error("The -C request count must be at least 1");
+	    break;
+	case 'F': /* Profile the heap layout every so many requests */
+	    layout_every = atoi(optarg);
+	    if (layout_every < 1)
+		app_error("The -F request count must be at least 1");
+	    break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -238,6 +410,12 @@ int main(int argc, char **argv)
     /* Initialize the timing package */
     init_fsecs();
 
+    /* With -j, traces are evaluated by up to this many worker processes */
+    if (jobs > 1) {
+	if ((workers = (pid_t *)calloc(jobs, sizeof(pid_t))) == NULL)
+	    unix_error("workers calloc in main failed");
+    }
+
     /*
      * Optionally run and evaluate the libc malloc package 
      */
@@ -246,17 +424,20 @@ int main(int argc, char **argv)
 	    printf("\nTesting libc malloc\n");
 	
 	/* Allocate libc stats array, with one stats_t struct per tracefile */
-	libc_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+	libc_stats = (stats_t *)shared_calloc(num_tracefiles, sizeof(stats_t));
 	if (libc_stats == NULL)
 	    unix_error("libc_stats calloc in main failed");
 	
 	/* Evaluate the libc malloc package using the K-best scheme */
 	for (i=0; i < num_tracefiles; i++) {
+	    if (jobs > 1 && fork_worker() < 0)
+		continue;
 	    trace = read_trace(tracedir, tracefiles[i]);
 	    libc_stats[i].ops = trace->num_ops;
 	    if (verbose > 1)
 		printf("Checking libc malloc for correctness, ");
-	    libc_stats[i].valid = eval_libc_valid(trace, i);
+	    libc_stats[i].valid = eval_libc_valid(trace, i,
+						  &libc_stats[i].copied);
 	    if (libc_stats[i].valid) {
 		speed_params.trace = trace;
 		if (verbose > 1)
@@ -264,7 +445,10 @@ int main(int argc, char **argv)
 		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
 	    }
 	    free_trace(trace);
+	    if (jobs > 1)
+		worker_exit();
 	}
+	wait_workers();
 
 	/* Display the libc results in a compact table */
 	if (verbose) {
@@ -280,37 +464,134 @@ int main(int argc, char **argv)
 	printf("\nTesting mm malloc\n");
 
     /* Allocate the mm stats array, with one stats_t struct per tracefile */
-    mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+    mm_stats = (stats_t *)shared_calloc(num_tracefiles, sizeof(stats_t));
     if (mm_stats == NULL)
 	unix_error("mm_stats calloc in main failed");
     
-    /* Initialize the simulated memory system in memlib.c */
+    /* 
+     * Allocate the benchmark results, and keep the runs on one CPU. 
+     * Workers started by -j each pin themselves to a CPU of their own.
+     */
+    if (bench_runs > 0) {
+	mm_bench = (bench_t *)shared_calloc(num_tracefiles, sizeof(bench_t));
+	if (mm_bench == NULL)
+	    unix_error("mm_bench calloc in main failed");
+	if (jobs == 1)
+	    cpu = pin_cpu(-1);
+    }
+    if (latency) {
+	mm_hists = (hist_t *)shared_calloc(NUM_OPTYPES*num_tracefiles, 
+					   sizeof(hist_t));
+	if (mm_hists == NULL)
+	    unix_error("mm_hists calloc in main failed");
+    }
+
+    /* 
+     * Initialize the simulated memory system in memlib.c. The heap is a
+     * private mapping, so each -j worker gets a copy of its own.
+     */
     mem_init(); 
 
     /* Evaluate student's mm malloc package using the K-best scheme */
     for (i=0; i < num_tracefiles; i++) {
+	if (jobs > 1) {
+	    if ((slot = fork_worker()) < 0)
+		continue;
+	    if (bench_runs > 0)
+		pin_cpu(slot);
+	}
 	trace = read_trace(tracedir, tracefiles[i]);
 	mm_stats[i].ops = trace->num_ops;
 	if (verbose > 1)
 	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
+	gettimeofday(&stv, NULL);
+	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges, 
+					  &mm_stats[i].copied);
+	gettimeofday(&etv, NULL);
+	mm_stats[i].check_secs = ELAPSED(stv, etv);
 	if (mm_stats[i].valid) {
 	    if (verbose > 1)
 		printf("efficiency, ");
 	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
+	    mm_stats[i].peak_heap = mem_peak_heapsize();
+	    mm_stats[i].peak_rss = mem_peak_resident();
 	    speed_params.trace = trace;
 	    speed_params.ranges = ranges;
 	    if (verbose > 1)
 		printf("and performance.\n");
 	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+	    if (bench_runs > 0)
+		eval_mm_bench(&speed_params, trace->num_ops, bench_runs,
+			      &mm_bench[i]);
+	    if (latency)
+		eval_mm_latency(trace, &mm_hists[NUM_OPTYPES*i]);
+	    if (layout_every > 0)
+		eval_mm_layout(trace, i, tracefiles[i], layout_every);
 	}
 	free_trace(trace);
+	if (jobs > 1)
+	    worker_exit();
     }
+    wait_workers();
 
     /* Display the mm results in a compact table */
     if (verbose) {
 	printf("\nResults for mm malloc:\n");
 	printresults(num_tracefiles, mm_stats);
+	printf("\nMemory footprint and checking cost of mm malloc:\n");
+	printmemory(num_tracefiles, mm_stats);
+	printf("\n");
+    }
+
+    /* Display the spread of the repeated runs */
+    if (bench_runs > 0) {
+	printf("\nBenchmark of mm malloc: %d runs after %d warmup runs, ",
+	       bench_runs, BENCH_WARMUP);
+	if (cpu >= 0)
+	    printf("pinned to CPU %d\n", cpu);
+	else if (jobs > 1)
+	    printf("one CPU per worker\n");
+	else
+	    printf("not pinned\n");
+	printbench(num_tracefiles, mm_stats, mm_bench);
+	printf("\n");
+	if (json_file != NULL)
+	    writejson(json_file, tracefiles, num_tracefiles, mm_stats, 
+		      mm_bench, bench_runs, cpu);
+    }
+
+    /* Display the tail latency of each type of request */
+    if (latency) {
+	printf("\nRequest latency of mm malloc in ns:\n");
+	printlatency(num_tracefiles, mm_stats, mm_hists);
+	printf("\n");
+    }
+
+    /*
+     * Optionally measure how mm throughput scales with the number of
+     * threads: 1, 2, 4, ... up to max_threads
+     */
+    if (max_threads > 0) {
+	printf("\nMultithreaded replay of mm malloc:\n");
+	printf("%5s%8s%10s%8s%8s\n", 
+	       "trace", "threads", "secs", "Kops", "speedup");
+	for (i=0; i < num_tracefiles; i++) {
+	    if (!mm_stats[i].valid)
+		continue;
+	    trace = read_trace(tracedir, tracefiles[i]);
+	    base_secs = 0;
+	    for (nthreads = 1; nthreads <= max_threads; 
+		 nthreads = (2*nthreads > max_threads && nthreads < max_threads) ?
+		     max_threads : 2*nthreads) {
+		secs = eval_mm_threads(trace, nthreads);
+		if (nthreads == 1)
+		    base_secs = secs;
+		printf("%2d%11d%10.6f%8.0f%7.2fx\n", 
+		       i, nthreads, secs, (trace->num_ops/1e3)/secs, 
+		       base_secs/secs);
+	    }
+	    free_trace(trace);
+	}
 	printf("\n");
     }
 
@@ -367,22 +648,25 @@ int main(int argc, char **argv)
 
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps 
+ * The following routines manipulate the range tree, which keeps 
  * track of the extent of every allocated block payload. We use the 
- * range list to detect any overlapping allocated blocks.
+ * range tree to detect any overlapping allocated blocks. It is an 
+ * AA tree (a simple balanced binary search tree) keyed by the low 
+ * payload address, so each check costs O(log n) in the number of 
+ * allocated blocks instead of a walk over all of them.
  ****************************************************************/
 
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of 
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list. 
+ *     we create a range struct for this block and add it to the range tree. 
  */
 static int add_range(range_t **ranges, char *lo, int size, 
 		     int tracenum, int opnum)
 {
     char *hi = lo + size - 1;
-    range_t *p;
+    range_t *p, *pred;
     char msg[MAXLINE];
 
     assert(size > 0);
@@ -395,36 +679,51 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
-	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
+    /* 
+     * The payload must lie within the extent of the heap, or within
+     * one of the mappings the package made with mem_map
+     */
+    if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
+	 (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+	!mem_is_mapped(lo, hi)) {
+	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p) and mappings",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
         return 0;
     }
 
-    /* The payload must not overlap any other payloads */
-    for (p = *ranges;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) ||
-            (hi >= p->lo && hi <= p->hi)) {
-	    sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-		    lo, hi, p->lo, p->hi);
-	    malloc_error(tracenum, opnum, msg);
-	    return 0;
-        }
+    /* 
+     * The payload must not overlap any other payloads. The payloads in
+     * the tree are disjoint, so only the one with the highest low
+     * address at or below hi can overlap the new one.
+     */
+    pred = NULL;
+    for (p = *ranges;  p != NULL; ) {
+	if (p->lo <= hi) {
+	    pred = p;
+	    p = p->right;
+	}
+	else
+	    p = p->left;
+    }
+    if (pred != NULL && pred->hi >= lo) {
+	sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+		lo, hi, pred->lo, pred->hi);
+	malloc_error(tracenum, opnum, msg);
+	return 0;
     }
 
     /* 
      * Everything looks OK, so remember the extent of this block 
-     * by creating a range struct and adding it the range list.
+     * by creating a range struct and adding it the range tree.
      */
     if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
 	unix_error("malloc error in add_range");
-    p->next = *ranges;
     p->lo = lo;
     p->hi = hi;
-    *ranges = p;
+    p->left = p->right = NULL;
+    p->level = 1;
+    *ranges = insert_range(*ranges, p);
     return 1;
 }
 
@@ -433,34 +732,121 @@ static int add_range(range_t **ranges, char *lo, int size,
  */
 static void remove_range(range_t **ranges, char *lo)
 {
-    range_t *p;
-    range_t **prevpp = ranges;
-    int size;
-
-    for (p = *ranges;  p != NULL; p = p->next) {
-        if (p->lo == lo) {
-	    *prevpp = p->next;
-            size = p->hi - p->lo + 1;
-            free(p);
-            break;
-        }
-        prevpp = &(p->next);
-    }
+    *ranges = delete_range(*ranges, lo);
 }
 
 /*
  * clear_ranges - free all of the range records for a trace 
  */
 static void clear_ranges(range_t **ranges)
+{
+    if (*ranges == NULL)
+	return;
+    clear_ranges(&(*ranges)->left);
+    clear_ranges(&(*ranges)->right);
+    free(*ranges);
+    *ranges = NULL;
+}
+
+/*
+ * skew - rotate right if t has a horizontal left link
+ */
+static range_t *skew(range_t *t)
+{
+    range_t *l;
+
+    if (t == NULL || t->left == NULL || t->left->level != t->level)
+	return t;
+    l = t->left;
+    t->left = l->right;
+    l->right = t;
+    return l;
+}
+
+/*
+ * split - rotate left and raise the middle node if t starts two 
+ *     consecutive horizontal right links
+ */
+static range_t *split(range_t *t)
+{
+    range_t *r;
+
+    if (t == NULL || t->right == NULL || t->right->right == NULL ||
+	t->right->right->level != t->level)
+	return t;
+    r = t->right;
+    t->right = r->left;
+    r->left = t;
+    r->level++;
+    return r;
+}
+
+/*
+ * insert_range - add node p to the tree rooted at t and return the 
+ *     new root
+ */
+static range_t *insert_range(range_t *t, range_t *p)
+{
+    if (t == NULL)
+	return p;
+    if (p->lo < t->lo)
+	t->left = insert_range(t->left, p);
+    else
+	t->right = insert_range(t->right, p);
+    return split(skew(t));
+}
+
+/*
+ * delete_range - free the node whose payload starts at lo, if any, from 
+ *     the tree rooted at t and return the new root
+ */
+static range_t *delete_range(range_t *t, char *lo)
 {
     range_t *p;
-    range_t *pnext;
+    int level;
+
+    if (t == NULL)
+	return NULL;
+
+    if (lo < t->lo)
+	t->left = delete_range(t->left, lo);
+    else if (lo > t->lo)
+	t->right = delete_range(t->right, lo);
+    else if (t->left == NULL && t->right == NULL) {
+	free(t);
+	return NULL;
+    }
+    else if (t->left == NULL) {
+	/* take over the extent of the successor, then delete it */
+	for (p = t->right; p->left != NULL; p = p->left)
+	    ;
+	t->lo = p->lo;
+	t->hi = p->hi;
+	t->right = delete_range(t->right, p->lo);
+    }
+    else {
+	/* take over the extent of the predecessor, then delete it */
+	for (p = t->left; p->right != NULL; p = p->right)
+	    ;
+	t->lo = p->lo;
+	t->hi = p->hi;
+	t->left = delete_range(t->left, p->lo);
+    }
 
-    for (p = *ranges;  p != NULL;  p = pnext) {
-        pnext = p->next;
-        free(p);
+    /* Lower t if a child got too low, then rebalance the right spine */
+    level = LEVEL(t->left) < LEVEL(t->right) ? LEVEL(t->left) : LEVEL(t->right);
+    if (level + 1 < t->level) {
+	t->level = level + 1;
+	if (t->right != NULL && t->right->level > t->level)
+	    t->right->level = t->level;
     }
-    *ranges = NULL;
+    t = skew(t);
+    t->right = skew(t->right);
+    if (t->right != NULL)
+	t->right->right = skew(t->right->right);
+    t = split(t);
+    t->right = split(t->right);
+    return t;
 }
 
 
@@ -477,9 +863,10 @@ static trace_t *read_trace(char *tracedir, char *filename)
     trace_t *trace;
     char type[MAXLINE];
     char path[MAXLINE];
-    unsigned index, size;
+    unsigned index, size, align;
     unsigned max_index = 0;
     unsigned op_index;
+    unsigned int magic;
 
     if (verbose > 1)
 	printf("Reading tracefile: %s\n", filename);
@@ -495,6 +882,17 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	sprintf(msg, "Could not open %s in read_trace", path);
 	unix_error(msg);
     }
+    trace->map = NULL;
+
+    /* Binary traces start with a magic number that no text trace has */
+    if (fread(&magic, sizeof(magic), 1, tracefile) == 1 && 
+	magic == BINTRACE_MAGIC) {
+	map_trace(trace, tracefile, path);
+	fclose(tracefile);
+	return trace;
+    }
+    rewind(tracefile);
+
     fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
     fscanf(tracefile, "%d", &(trace->num_ids));     
     fscanf(tracefile, "%d", &(trace->num_ops));     
@@ -519,6 +917,7 @@ static trace_t *read_trace(char *tracedir, char *filename)
     index = 0;
     op_index = 0;
     while (fscanf(tracefile, "%s", type) != EOF) {
+	trace->ops[op_index].align = 0;
 	switch(type[0]) {
 	case 'a':
 	    fscanf(tracefile, "%u %u", &index, &size);
@@ -534,6 +933,21 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	    trace->ops[op_index].size = size;
 	    max_index = (index > max_index) ? index : max_index;
 	    break;
+	case 'c':
+	    fscanf(tracefile, "%u %u", &index, &size);
+	    trace->ops[op_index].type = CALLOC;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'm':
+	    fscanf(tracefile, "%u %u %u", &index, &align, &size);
+	    trace->ops[op_index].type = MEMALIGN;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    trace->ops[op_index].align = align;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
 	case 'f':
 	    fscanf(tracefile, "%ud", &index);
 	    trace->ops[op_index].type = FREE;
@@ -554,13 +968,101 @@ static trace_t *read_trace(char *tracedir, char *filename)
     return trace;
 }
 
+/*
+ * map_trace - Map the binary trace in tracefile (see bintrace.h) and
+ *     use its op records in place as the trace's request array. The
+ *     shorter records of a version 1 file are copied instead. A file
+ *     with a bad header or a record of an unknown type or out of range
+ *     index is rejected.
+ */
+static void map_trace(trace_t *trace, FILE *tracefile, char *path)
+{
+    struct stat st;
+    bintrace_hdr_t *hdr;
+    size_t opsize;
+    int i;
+
+    if (fstat(fileno(tracefile), &st) < 0)
+	unix_error("fstat failed in map_trace");
+    if ((size_t)st.st_size < sizeof(bintrace_hdr_t)) {
+	sprintf(msg, "Truncated binary trace %s", path);
+	app_error(msg);
+    }
+    trace->map_len = st.st_size;
+    trace->map = mmap(NULL, trace->map_len, PROT_READ, MAP_PRIVATE, 
+		      fileno(tracefile), 0);
+    if (trace->map == MAP_FAILED) {
+	sprintf(msg, "Could not mmap %s in map_trace", path);
+	unix_error(msg);
+    }
+
+    hdr = (bintrace_hdr_t *)trace->map;
+    opsize = (hdr->version == 1) ? sizeof(bintrace_op_v1_t) : 
+	sizeof(bintrace_op_t);
+    if ((hdr->version != 1 && hdr->version != BINTRACE_VERSION) ||
+	hdr->num_ops < 0 || hdr->num_ids < 0 || trace->map_len != 
+	sizeof(bintrace_hdr_t) + (size_t)hdr->num_ops * opsize) {
+	sprintf(msg, "Bad header in binary trace %s", path);
+	app_error(msg);
+    }
+    trace->sugg_heapsize = hdr->sugg_heapsize;
+    trace->num_ids = hdr->num_ids;
+    trace->num_ops = hdr->num_ops;
+    trace->weight = hdr->weight;
+    if (hdr->version == 1)
+	copy_v1_ops(trace, (bintrace_op_v1_t *)(hdr + 1));
+    else
+	trace->ops = (traceop_t *)(hdr + 1);
+
+    /* the records index blocks[] directly, so check them all once */
+    for (i = 0; i < trace->num_ops; i++) {
+	if ((unsigned)trace->ops[i].type > MEMALIGN ||
+	    (unsigned)trace->ops[i].index >= (unsigned)trace->num_ids) {
+	    sprintf(msg, "Bad op record %d in binary trace %s", i, path);
+	    app_error(msg);
+	}
+    }
+
+    if ((trace->blocks = 
+	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+	unix_error("malloc 3 failed in map_trace");
+    if ((trace->block_sizes = 
+	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
+	unix_error("malloc 4 failed in map_trace");
+}
+
+/*
+ * copy_v1_ops - Copy the version 1 op records of a mapped binary trace
+ *     into a request array of its own, and unmap the file
+ */
+static void copy_v1_ops(trace_t *trace, bintrace_op_v1_t *ops)
+{
+    int i;
+
+    if ((trace->ops = 
+	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+	unix_error("malloc failed in copy_v1_ops");
+    for (i = 0; i < trace->num_ops; i++) {
+	trace->ops[i].type = ops[i].type;
+	trace->ops[i].index = ops[i].index;
+	trace->ops[i].size = ops[i].size;
+	trace->ops[i].align = 0;
+    }
+    munmap(trace->map, trace->map_len);
+    trace->map = NULL;
+}
+
 /*
  * free_trace - Free the trace record and the three arrays it points
  *              to, all of which were allocated in read_trace().
+ *              The request array of a binary trace is unmapped.
  */
 void free_trace(trace_t *trace)
 {
-    free(trace->ops);         /* free the three arrays... */
+    if (trace->map != NULL)   /* free the three arrays... */
+	munmap(trace->map, trace->map_len);
+    else
+	free(trace->ops);
     free(trace->blocks);      
     free(trace->block_sizes);
     free(trace);              /* and the trace record itself... */
@@ -572,9 +1074,48 @@ void free_trace(trace_t *trace)
  **********************************************************************/
 
 /*
- * eval_mm_valid - Check the mm malloc package for correctness
+ * mm_alloc_op - Carry out the ALLOC, CALLOC or MEMALIGN request op with
+ *     the mm package. A calloc asks for a single object of the size.
+ */
+static char *mm_alloc_op(traceop_t *op)
+{
+    switch (op->type) {
+    case CALLOC:
+	return mm_calloc(1, op->size);
+    case MEMALIGN:
+	return mm_memalign(op->align, op->size);
+    default:
+	return mm_malloc(op->size);
+    }
+}
+
+/*
+ * libc_alloc_op - Carry out the same request with the libc package
  */
-static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) 
+static char *libc_alloc_op(traceop_t *op)
+{
+    void *p;
+
+    switch (op->type) {
+    case CALLOC:
+	return calloc(1, op->size);
+    case MEMALIGN:
+	if (posix_memalign(&p, (op->align < (int)sizeof(void *)) ? 
+			   sizeof(void *) : (size_t)op->align, op->size) != 0)
+	    return NULL;
+	return p;
+    default:
+	return malloc(op->size);
+    }
+}
+
+/*
+ * eval_mm_valid - Check the mm malloc package for correctness. Also 
+ *     counts the payload bytes that realloc had to copy, i.e. the 
+ *     preserved bytes of every block that realloc moved.
+ */
+static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges,
+			 double *copied) 
 {
     int i, j;
     int index;
@@ -583,10 +1124,12 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
     char *newp;
     char *oldp;
     char *p;
+    traceop_t *op;
     
-    /* Reset the heap and free any records in the range list */
+    /* Reset the heap and free any records in the range tree */
     mem_reset_brk();
     clear_ranges(ranges);
+    *copied = 0;
 
     /* Call the mm package's init function */
     if (mm_init() < 0) {
@@ -596,26 +1139,52 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 
     /* Interpret each operation in the trace in order */
     for (i = 0;  i < trace->num_ops;  i++) {
-	index = trace->ops[i].index;
-	size = trace->ops[i].size;
+	op = &trace->ops[i];
+	index = op->index;
+	size = op->size;
 
-        switch (trace->ops[i].type) {
+        switch (op->type) {
 
         case ALLOC: /* mm_malloc */
+        case CALLOC: /* mm_calloc */
+        case MEMALIGN: /* mm_memalign */
 
 	    /* Call the student's malloc */
-	    if ((p = mm_malloc(size)) == NULL) {
-		malloc_error(tracenum, i, "mm_malloc failed.");
+	    if ((p = mm_alloc_op(op)) == NULL) {
+		sprintf(msg, "mm_%s failed.", op_names[op->type]);
+		malloc_error(tracenum, i, msg);
 		return 0;
 	    }
 	    
 	    /* 
 	     * Test the range of the new block for correctness and add it 
-	     * to the range list if OK. The block must be  be aligned properly,
+	     * to the range tree if OK. The block must be  be aligned properly,
 	     * and must not overlap any currently allocated block. 
 	     */ 
 	    if (add_range(ranges, p, size, tracenum, i) == 0)
 		return 0;
+
+	    /* calloc promises zeros, memalign a stricter alignment */
+	    if (op->type == CALLOC) {
+		for (j = 0; j < size; j++) {
+		    if (p[j] != 0) {
+			malloc_error(tracenum, i, "mm_calloc did not zero "
+				     "the block");
+			return 0;
+		    }
+		}
+	    }
+	    if (op->type == MEMALIGN && (op->align <= 0 || 
+					 (size_t)p % op->align != 0)) {
+		malloc_error(tracenum, i, "mm_memalign did not align the "
+			     "block");
+		return 0;
+	    }
+	    if (mm_malloc_usable_size(p) < (size_t)size) {
+		malloc_error(tracenum, i, "mm_malloc_usable_size is less "
+			     "than the size requested");
+		return 0;
+	    }
 	    
 	    /* ADDED: cgw
 	     * fill range with low byte of index.  This will be used later
@@ -638,12 +1207,17 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 		return 0;
 	    }
 	    
-	    /* Remove the old region from the range list */
+	    /* Remove the old region from the range tree */
 	    remove_range(ranges, oldp);
 	    
-	    /* Check new block for correctness and add it to range list */
+	    /* Check new block for correctness and add it to range tree */
 	    if (add_range(ranges, newp, size, tracenum, i) == 0)
 		return 0;
+	    if (mm_malloc_usable_size(newp) < (size_t)size) {
+		malloc_error(tracenum, i, "mm_malloc_usable_size is less "
+			     "than the size requested");
+		return 0;
+	    }
 	    
 	    /* ADDED: cgw
 	     * Make sure that the new block contains the data from the old 
@@ -652,8 +1226,10 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	     */
 	    oldsize = trace->block_sizes[index];
 	    if (size < oldsize) oldsize = size;
+	    if (newp != oldp)
+		*copied += oldsize;
 	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	      if ((unsigned char)newp[j] != (index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
@@ -678,6 +1254,12 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    app_error("Nonexistent request type in eval_mm_valid");
         }
 
+	/* Optionally have the package check its own data structures */
+	if (check_every > 0 && (i+1) % check_every == 0 &&
+	    mm_checkheap(check_level) != 0) {
+	    malloc_error(tracenum, i, "mm_checkheap found the heap inconsistent");
+	    return 0;
+	}
     }
 
     /* As far as we know, this is a valid malloc package */
@@ -689,11 +1271,14 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for 
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the 
- *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
- *   
+ *   largest size the heap reached while running the student's malloc 
+ *   package on the trace, counting the mappings the package made with
+ *   mem_map() as part of the heap. mem_sbrk() lets the package shrink
+ *   the heap, so the final brk is not necessarily the high water mark. The heap
+ *   pages are released first, so that memlib's peak resident size
+ *   afterwards belongs to this trace alone. This is the only run in
+ *   which memlib samples the resident size, as sampling is too slow
+ *   for the timed runs.
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 {   
@@ -706,7 +1291,8 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
     char *newp, *oldp;
 
     /* initialize the heap and the mm malloc package */
-    mem_reset_brk();
+    mem_release();
+    mem_sample_resident(1);
     if (mm_init() < 0)
 	app_error("mm_init failed in eval_mm_util");
 
@@ -714,10 +1300,12 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_alloc */
+        case CALLOC: /* mm_calloc */
+        case MEMALIGN: /* mm_memalign */
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
 
-	    if ((p = mm_malloc(size)) == NULL) 
+	    if ((p = mm_alloc_op(&trace->ops[i])) == NULL) 
 		app_error("mm_malloc failed in eval_mm_util");
 	    
 	    /* Remember region and size */
@@ -774,7 +1362,8 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
         }
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    mem_sample_resident(0);
+    return ((double)max_total_size / (double)mem_peak_heapsize());
 }
 
 
@@ -784,7 +1373,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index, size, newsize;
+    int i, index, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
@@ -798,9 +1387,10 @@ static void eval_mm_speed(void *ptr)
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_malloc */
+        case CALLOC: /* mm_calloc */
+        case MEMALIGN: /* mm_memalign */
             index = trace->ops[i].index;
-            size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
+            if ((p = mm_alloc_op(&trace->ops[i])) == NULL)
 		app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
             break;
@@ -825,26 +1415,370 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm_bench - Time runs separate replays of a trace by mm malloc,
+ *     after BENCH_WARMUP untimed ones, and summarize their throughput.
+ *     Unlike fsecs, which reports a single average, this shows how
+ *     much the throughput varies from run to run.
+ */
+static void eval_mm_bench(speed_t *params, double ops, int runs, 
+			  bench_t *bench)
+{
+    double *secs;
+    double kops, sum = 0, sumsq = 0, mean;
+    int i;
+
+    if ((secs = (double *)malloc(runs * sizeof(double))) == NULL)
+	unix_error("malloc failed in eval_mm_bench");
+    ftimer_samples(eval_mm_speed, params, BENCH_WARMUP, runs, secs);
+
+    for (i = 0; i < runs; i++) {
+	kops = ops/1e3/secs[i];
+	sum += kops;
+	sumsq += kops*kops;
+    }
+    mean = sum/runs;
+    bench->stddev = (runs > 1) ? 
+	sqrt((sumsq - runs*mean*mean)/(runs - 1)) : 0;
+    if (bench->stddev != bench->stddev) /* rounding made sumsq too small */
+	bench->stddev = 0;
+
+    /* The percentiles use the nearest-rank method on the sorted times */
+    qsort(secs, runs, sizeof(double), cmp_double);
+    bench->max = ops/1e3/secs[0];
+    bench->median = ops/1e3/secs[(runs - 1)/2];
+    bench->p99 = ops/1e3/secs[(99*runs + 99)/100 - 1];
+    bench->min = ops/1e3/secs[runs - 1];
+    free(secs);
+}
+
+/*
+ * eval_mm_latency - Replay a trace like eval_mm_speed, but time every
+ *     request on its own and add its latency to hists[type], one
+ *     histogram per request type. The clock is read twice per 
+ *     request, so the histograms include about one clock read of 
+ *     overhead, but they show the rare slow requests (coalescing, 
+ *     heap growth) that an average over the trace hides.
+ */
+static void eval_mm_latency(trace_t *trace, hist_t *hists)
+{
+    int i, index;
+    char *p;
+    struct timespec sts, ets;
+
+    mem_reset_brk();
+    if (mm_init() < 0) 
+	app_error("mm_init failed in eval_mm_latency");
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+	index = trace->ops[i].index;
+	switch (trace->ops[i].type) {
+
+	case ALLOC: /* mm_malloc */
+	case CALLOC: /* mm_calloc */
+	case MEMALIGN: /* mm_memalign */
+	    clock_gettime(FTIMER_CLOCK, &sts);
+	    p = mm_alloc_op(&trace->ops[i]);
+	    clock_gettime(FTIMER_CLOCK, &ets);
+	    if (p == NULL)
+		app_error("mm_malloc error in eval_mm_latency");
+	    trace->blocks[index] = p;
+	    break;
+
+	case REALLOC: /* mm_realloc */
+	    clock_gettime(FTIMER_CLOCK, &sts);
+	    p = mm_realloc(trace->blocks[index], trace->ops[i].size);
+	    clock_gettime(FTIMER_CLOCK, &ets);
+	    if (p == NULL)
+		app_error("mm_realloc error in eval_mm_latency");
+	    trace->blocks[index] = p;
+	    break;
+
+	case FREE: /* mm_free */
+	    clock_gettime(FTIMER_CLOCK, &sts);
+	    mm_free(trace->blocks[index]);
+	    clock_gettime(FTIMER_CLOCK, &ets);
+	    break;
+
+	default:
+	    app_error("Nonexistent request type in eval_mm_latency");
+	}
+	hist_add(&hists[trace->ops[i].type], 
+		 (ets.tv_sec - sts.tv_sec)*1000000000L + 
+		 (ets.tv_nsec - sts.tv_nsec));
+    }
+}
+
+/*
+ * eval_mm_layout - Replay a trace and, after every "every" requests and
+ *     at the end, walk the heap with mm_heap_walk. Each walk becomes one
+ *     tab-separated line of <trace name>.layout in the current 
+ *     directory: the heap size, the live payload, the allocated, 
+ *     overhead and free bytes, the number of free blocks and the 
+ *     largest one, the external fragmentation (the share of the free
+ *     bytes outside the largest free block), the number of free blocks
+ *     of each power-of-two size, and the allocated and free bytes in
+ *     each of the package's size classes.
+ */
+static void eval_mm_layout(trace_t *trace, int tracenum, char *filename,
+			   int every)
+{
+    char path[MAXLINE/2];     /* leaves room for it in msg */
+    char *name;
+    FILE *fp;
+    layout_t l;
+    double payload = 0;
+    int i, k, index, size;
+    char *p;
+
+    name = strrchr(filename, '/') ? strrchr(filename, '/') + 1 : filename;
+    snprintf(path, sizeof(path), "%s.layout", name);
+    if ((fp = fopen(path, "w")) == NULL) {
+	sprintf(msg, "Could not open %s in eval_mm_layout", path);
+	unix_error(msg);
+    }
+    l.class_alloc = (double *)malloc(mm_num_classes * sizeof(double));
+    l.class_free = (double *)malloc(mm_num_classes * sizeof(double));
+    if (l.class_alloc == NULL || l.class_free == NULL)
+	unix_error("malloc failed in eval_mm_layout");
+
+    fprintf(fp, "op\theap\tpayload\talloc\toverhead\tfree\tnfree\t"
+	    "largest\textfrag");
+    for (k = 0; k < LAYOUT_BINS; k++)
+	fprintf(fp, "\tfree_%d%s", 1 << (k + 4), 
+		(k == LAYOUT_BINS - 1) ? "+" : "");
+    for (k = 0; k < mm_num_classes; k++)
+	fprintf(fp, "\tclass%d_alloc\tclass%d_free", k, k);
+    fprintf(fp, "\n");
+
+    mem_reset_brk();
+    if (mm_init() < 0) 
+	app_error("mm_init failed in eval_mm_layout");
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+	switch (trace->ops[i].type) {
+
+	case ALLOC: /* mm_malloc */
+	case CALLOC: /* mm_calloc */
+	case MEMALIGN: /* mm_memalign */
+	    if ((p = mm_alloc_op(&trace->ops[i])) == NULL)
+		app_error("mm_malloc error in eval_mm_layout");
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    payload += size;
+	    break;
+
+	case REALLOC: /* mm_realloc */
+	    if ((p = mm_realloc(trace->blocks[index], size)) == NULL)
+		app_error("mm_realloc error in eval_mm_layout");
+	    trace->blocks[index] = p;
+	    payload += size - (double)trace->block_sizes[index];
+	    trace->block_sizes[index] = size;
+	    break;
+
+	case FREE: /* mm_free */
+	    mm_free(trace->blocks[index]);
+	    payload -= trace->block_sizes[index];
+	    trace->block_sizes[index] = 0;
+	    break;
+
+	default:
+	    app_error("Nonexistent request type in eval_mm_layout");
+	}
+
+	if ((i + 1) % every == 0 || i == trace->num_ops - 1) {
+	    l.alloc = l.overhead = l.free = l.largest = 0;
+	    l.nfree = 0;
+	    memset(l.free_sizes, 0, sizeof(l.free_sizes));
+	    for (k = 0; k < mm_num_classes; k++)
+		l.class_alloc[k] = l.class_free[k] = 0;
+	    mm_heap_walk(layout_block, &l);
+	    write_layout(fp, i + 1, payload, &l);
+	}
+    }
+
+    free(l.class_alloc);
+    free(l.class_free);
+    if (fclose(fp) != 0)
+	unix_error("fclose failed in eval_mm_layout");
+    printf("Heap layout of trace %d written to %s\n", tracenum, path);
+}
+
+/*
+ * layout_block - add one block found by mm_heap_walk to the layout_t
+ *     that arg points to
+ */
+static void layout_block(const mm_block_t *block, void *arg)
+{
+    layout_t *l = (layout_t *)arg;
+    int bin;
+
+    if (block->allocated) {
+	l->alloc += block->size;
+	l->overhead += block->overhead;
+	l->class_alloc[block->size_class] += block->size;
+	return;
+    }
+
+    l->free += block->size;
+    l->nfree++;
+    if (block->size > l->largest)
+	l->largest = block->size;
+    l->class_free[block->size_class] += block->size;
+    for (bin = 0; bin < LAYOUT_BINS - 1 && (block->size >> (bin + 5)); bin++)
+	;
+    l->free_sizes[bin]++;
+}
+
+/*
+ * write_layout - write the -F profile line for the heap walk l, taken
+ *     after request opnum with payload bytes in use
+ */
+static void write_layout(FILE *fp, int opnum, double payload, layout_t *l)
+{
+    int k;
+
+    fprintf(fp, "%d\t%lu\t%.0f\t%.0f\t%.0f\t%.0f\t%d\t%.0f\t%.4f", 
+	    opnum, (unsigned long)mem_heapsize(), payload, l->alloc, 
+	    l->overhead, l->free, l->nfree, l->largest, 
+	    (l->free > 0) ? 1 - l->largest / l->free : 0);
+    for (k = 0; k < LAYOUT_BINS; k++)
+	fprintf(fp, "\t%d", l->free_sizes[k]);
+    for (k = 0; k < mm_num_classes; k++)
+	fprintf(fp, "\t%.0f\t%.0f", l->class_alloc[k], l->class_free[k]);
+    fprintf(fp, "\n");
+}
+
+/*
+ * eval_mm_threads - Replay a trace with nthreads threads and return the
+ *    average wall-clock time of one replay. The block ids are dealt out
+ *    round robin, so each thread runs every request for its own ids in
+ *    trace order and no two threads ever touch the same block.
+ */
+static double eval_mm_threads(trace_t *trace, int nthreads)
+{
+    int i, t, run;
+    int runs = 10;
+    thread_arg_t *args;
+    pthread_t *tids;
+    pthread_barrier_t start;
+    double first, last, secs = 0;
+
+    if ((args = (thread_arg_t *)calloc(nthreads, sizeof(thread_arg_t))) == NULL ||
+	(tids = (pthread_t *)malloc(nthreads * sizeof(pthread_t))) == NULL)
+	unix_error("malloc failed in eval_mm_threads");
+
+    /* Split the requests by id before any timing starts */
+    for (t = 0; t < nthreads; t++) {
+	if ((args[t].ops = 
+	     (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+	    unix_error("malloc failed in eval_mm_threads");
+	args[t].blocks = trace->blocks;
+	args[t].start = &start;
+    }
+    for (i = 0; i < trace->num_ops; i++) {
+	t = trace->ops[i].index % nthreads;
+	args[t].ops[args[t].num_ops++] = trace->ops[i];
+    }
+
+    for (run = 0; run < runs; run++) {
+	mem_reset_brk();
+	if (mm_init() < 0)
+	    app_error("mm_init failed in eval_mm_threads");
+
+	pthread_barrier_init(&start, NULL, nthreads + 1);
+	for (t = 0; t < nthreads; t++)
+	    if (pthread_create(&tids[t], NULL, replay_thread, &args[t]) != 0)
+		unix_error("pthread_create failed in eval_mm_threads");
+	pthread_barrier_wait(&start);
+	for (t = 0; t < nthreads; t++)
+	    pthread_join(tids[t], NULL);
+	pthread_barrier_destroy(&start);
+
+	/* The replay runs from the first thread start to the last finish */
+	first = DBL_MAX;
+	last = 0;
+	for (t = 0; t < nthreads; t++) {
+	    if (args[t].stv.tv_sec + 1E-6*args[t].stv.tv_usec < first)
+		first = args[t].stv.tv_sec + 1E-6*args[t].stv.tv_usec;
+	    if (args[t].etv.tv_sec + 1E-6*args[t].etv.tv_usec > last)
+		last = args[t].etv.tv_sec + 1E-6*args[t].etv.tv_usec;
+	}
+	secs += last - first;
+    }
+
+    for (t = 0; t < nthreads; t++)
+	free(args[t].ops);
+    free(args);
+    free(tids);
+    return secs / runs;
+}
+
+/*
+ * replay_thread - Thread routine for eval_mm_threads. Runs one
+ *    thread's share of the trace against the mm package.
+ */
+static void *replay_thread(void *vargp)
+{
+    thread_arg_t *arg = (thread_arg_t *)vargp;
+    traceop_t *op;
+    char *p;
+    int i;
+
+    pthread_barrier_wait(arg->start);
+    gettimeofday(&arg->stv, NULL);
+    for (i = 0; i < arg->num_ops; i++) {
+	op = &arg->ops[i];
+	switch (op->type) {
+	case ALLOC: /* mm_malloc */
+	case CALLOC: /* mm_calloc */
+	case MEMALIGN: /* mm_memalign */
+	    if ((p = mm_alloc_op(op)) == NULL)
+		app_error("mm_malloc error in replay_thread");
+	    arg->blocks[op->index] = p;
+	    break;
+
+	case REALLOC: /* mm_realloc */
+	    if ((p = mm_realloc(arg->blocks[op->index], op->size)) == NULL)
+		app_error("mm_realloc error in replay_thread");
+	    arg->blocks[op->index] = p;
+	    break;
+
+	case FREE: /* mm_free */
+	    mm_free(arg->blocks[op->index]);
+	    break;
+	}
+    }
+    gettimeofday(&arg->etv, NULL);
+    return NULL;
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
  *    We'll be conservative and terminate if any libc malloc call fails.
  *
  */
-static int eval_libc_valid(trace_t *trace, int tracenum)
+static int eval_libc_valid(trace_t *trace, int tracenum, double *copied)
 {
-    int i, newsize;
+    int i, newsize, oldsize;
     char *p, *newp, *oldp;
 
+    *copied = 0;
     for (i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
 
         case ALLOC: /* malloc */
-	    if ((p = malloc(trace->ops[i].size)) == NULL) {
+        case CALLOC: /* calloc */
+        case MEMALIGN: /* posix_memalign */
+	    if ((p = libc_alloc_op(&trace->ops[i])) == NULL) {
 		malloc_error(tracenum, i, "libc malloc failed");
 		unix_error("System message");
 	    }
 	    trace->blocks[trace->ops[i].index] = p;
+	    trace->block_sizes[trace->ops[i].index] = trace->ops[i].size;
 	    break;
 
 	case REALLOC: /* realloc */
@@ -854,7 +1788,11 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 		malloc_error(tracenum, i, "libc realloc failed");
 		unix_error("System message");
 	    }
+	    oldsize = trace->block_sizes[trace->ops[i].index];
+	    if (newp != oldp)
+		*copied += (newsize < oldsize) ? newsize : oldsize;
 	    trace->blocks[trace->ops[i].index] = newp;
+	    trace->block_sizes[trace->ops[i].index] = newsize;
 	    break;
 	    
         case FREE: /* free */
@@ -877,16 +1815,17 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 static void eval_libc_speed(void *ptr)
 {
     int i;
-    int index, size, newsize;
+    int index, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
     for (i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
         case ALLOC: /* malloc */
+        case CALLOC: /* calloc */
+        case MEMALIGN: /* posix_memalign */
 	    index = trace->ops[i].index;
-	    size = trace->ops[i].size;
-	    if ((p = malloc(size)) == NULL)
+	    if ((p = libc_alloc_op(&trace->ops[i])) == NULL)
 		unix_error("malloc failed in eval_libc_speed");
 	    trace->blocks[index] = p;
 	    break;
@@ -924,54 +1863,359 @@ static void printresults(int n, stats_t *stats)
     double secs = 0;
     double ops = 0;
     double util = 0;
+    double copied = 0;
 
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
-	   "trace", " valid", "util", "ops", "secs", "Kops");
+    printf("%5s%7s %5s%9s%10s%6s%10s\n", 
+	   "trace", " valid", "util", "ops", "secs", "Kops", "KBcopied");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%9.0f%10.6f%6.0f%10.0f\n", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
-		   (stats[i].ops/1e3)/stats[i].secs);
+		   (stats[i].ops/1e3)/stats[i].secs,
+		   stats[i].copied/1024);
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
+	    copied += stats[i].copied;
 	}
 	else {
-	    printf("%2d%10s%6s%8s%10s%6s\n", 
+	    printf("%2d%10s%6s%9s%10s%6s%10s\n", 
 		   i,
 		   "no",
 		   "-",
 		   "-",
 		   "-",
+		   "-",
 		   "-");
 	}
     }
 
     /* Print the aggregate results for the set of traces */
     if (errors == 0) {
-	printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	printf("%12s%5.0f%%%9.0f%10.6f%6.0f%10.0f\n", 
 	       "Total       ",
 	       (util/n)*100.0,
 	       ops, 
 	       secs,
-	       (ops/1e3)/secs);
+	       (ops/1e3)/secs,
+	       copied/1024);
     }
     else {
-	printf("%12s%6s%8s%10s%6s\n", 
+	printf("%12s%6s%8s%10s%6s%10s\n", 
 	       "Total       ",
 	       "-", 
 	       "-", 
 	       "-", 
+	       "-",
 	       "-");
     }
 
 }
 
+/*
+ * printmemory - prints the peak heap size, the peak resident heap size
+ *     and the time spent checking correctness for each trace
+ */
+static void printmemory(int n, stats_t *stats) 
+{
+    int i;
+
+    printf("%5s%15s%15s%12s\n", 
+	   "trace", "peak heap KB", "peak RSS KB", "check secs");
+    for (i=0; i < n; i++) {
+	if (stats[i].valid)
+	    printf("%2d%18.0f%15.0f%12.6f\n", 
+		   i, stats[i].peak_heap/1024, stats[i].peak_rss/1024,
+		   stats[i].check_secs);
+	else
+	    printf("%2d%18s%15s%12.6f\n", i, "-", "-", stats[i].check_secs);
+    }
+}
+
+/*
+ * printbench - prints the spread of the -B runs for each trace
+ */
+static void printbench(int n, stats_t *stats, bench_t *bench)
+{
+    int i;
+
+    printf("%5s%10s%12s%10s%10s%10s%10s\n", "trace", "ops", 
+	   "median Kops", "p99 Kops", "stddev", "min Kops", "max Kops");
+    for (i=0; i < n; i++) {
+	if (stats[i].valid)
+	    printf("%2d%13.0f%12.0f%10.0f%10.0f%10.0f%10.0f\n", i, stats[i].ops,
+		   bench[i].median, bench[i].p99, bench[i].stddev,
+		   bench[i].min, bench[i].max);
+	else
+	    printf("%2d%13.0f%12s%10s%10s%10s%10s\n", i, stats[i].ops,
+		   "-", "-", "-", "-", "-");
+    }
+}
+
+/*
+ * writejson - write the -B results to filename ("-" for stdout) as a
+ *     JSON object, so that they can be compared from commit to commit
+ */
+static void writejson(char *filename, char **tracefiles, int n, 
+		      stats_t *stats, bench_t *bench, int runs, int cpu)
+{
+    FILE *fp;
+    char *c;
+    int i;
+
+    if (!strcmp(filename, "-"))
+	fp = stdout;
+    else if ((fp = fopen(filename, "w")) == NULL) {
+	sprintf(msg, "Could not open %s in writejson", filename);
+	unix_error(msg);
+    }
+
+    fprintf(fp, "{\n  \"runs\": %d,\n  \"warmup\": %d,\n  \"cpu\": %d,\n", 
+	    runs, BENCH_WARMUP, cpu);
+    fprintf(fp, "  \"traces\": [\n");
+    for (i = 0; i < n; i++) {
+	fprintf(fp, "    {\"trace\": \"");
+	for (c = tracefiles[i]; *c; c++) {
+	    if (*c == '"' || *c == '\\')
+		fputc('\\', fp);
+	    fputc(*c, fp);
+	}
+	fprintf(fp, "\", \"ops\": %.0f, \"valid\": %s", 
+		stats[i].ops, stats[i].valid ? "true" : "false");
+	if (stats[i].valid)
+	    fprintf(fp, ", \"util\": %.4f, \"median_kops\": %.1f, "
+		    "\"p99_kops\": %.1f, \"stddev_kops\": %.1f, "
+		    "\"min_kops\": %.1f, \"max_kops\": %.1f",
+		    stats[i].util, bench[i].median, bench[i].p99, 
+		    bench[i].stddev, bench[i].min, bench[i].max);
+	fprintf(fp, "}%s\n", (i < n - 1) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    if (fp != stdout && fclose(fp) != 0)
+	unix_error("fclose failed in writejson");
+}
+
+/*
+ * hist_add - count a latency of ns nanoseconds in hist
+ */
+static void hist_add(hist_t *hist, long ns)
+{
+    int bits, bucket;
+
+    if (ns < 0)
+	ns = 0;
+    if (ns > hist->max)
+	hist->max = ns;
+    hist->total++;
+
+    /* Values below HIST_SUB get a bucket each; above that, the top 
+       HIST_SUB_BITS bits after the leading one pick the bucket */
+    if (ns < HIST_SUB)
+	bucket = ns;
+    else {
+	bits = HIST_SUB_BITS;
+	while (bits < HIST_MAX_BITS - 1 && (ns >> (bits + 1)))
+	    bits++;
+	if (ns >> (bits + 1))
+	    bucket = HIST_BUCKETS - 1;
+	else
+	    bucket = (bits - HIST_SUB_BITS + 1) * HIST_SUB +
+		((ns >> (bits - HIST_SUB_BITS)) & (HIST_SUB - 1));
+    }
+    hist->count[bucket]++;
+}
+
+/*
+ * hist_percentile - return the latency that a fraction q of the 
+ *     requests in hist did not exceed: the largest value of the bucket
+ *     where the count reaches q*total, but never more than the maximum
+ */
+static long hist_percentile(hist_t *hist, double q)
+{
+    long rank, seen = 0, hi;
+    int bucket, bits;
+
+    if (hist->total == 0)
+	return 0;
+    rank = (long)ceil(q * hist->total);
+    if (rank < 1)
+	rank = 1;
+    for (bucket = 0; bucket < HIST_BUCKETS - 1; bucket++) {
+	seen += hist->count[bucket];
+	if (seen >= rank)
+	    break;
+    }
+    if (bucket < HIST_SUB)
+	hi = bucket;
+    else {
+	bits = bucket / HIST_SUB + HIST_SUB_BITS - 1;
+	hi = ((long)(HIST_SUB + bucket % HIST_SUB + 1) 
+	      << (bits - HIST_SUB_BITS)) - 1;
+    }
+    return hi < hist->max ? hi : hist->max;
+}
+
+/*
+ * printlatency - prints the latency percentiles of each type of 
+ *     request for each trace
+ */
+static void printlatency(int n, stats_t *stats, hist_t *hists)
+{
+    hist_t *h;
+    int i, type;
+
+    printf("%5s%9s%10s%8s%8s%8s%10s\n", 
+	   "trace", "request", "count", "p50", "p99", "p99.9", "max");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid) {
+	    printf("%2d%12s\n", i, "-");
+	    continue;
+	}
+	for (type = ALLOC; type < NUM_OPTYPES; type++) {
+	    h = &hists[NUM_OPTYPES*i + type];
+	    if (h->total == 0)
+		continue;
+	    printf("%2d%12s%10ld%8ld%8ld%8ld%10ld\n", i, op_names[type], h->total,
+		   hist_percentile(h, 0.50), hist_percentile(h, 0.99),
+		   hist_percentile(h, 0.999), h->max);
+	}
+    }
+}
+
+/*
+ * pin_cpu - keep this process on one CPU, so that repeated runs see the
+ *     same caches. That is the CPU it is running on if slot is negative,
+ *     and otherwise the slot'th (modulo their number) of the CPUs it may
+ *     run on, which keeps -j workers apart. Returns the CPU, or -1 if 
+ *     the process could not be pinned.
+ */
+static int pin_cpu(int slot)
+{
+    cpu_set_t set;
+    int cpu, n;
+
+    if (slot < 0) {
+	if ((cpu = sched_getcpu()) < 0)
+	    return -1;
+    }
+    else {
+	if (sched_getaffinity(0, sizeof(set), &set) < 0 || 
+	    (n = CPU_COUNT(&set)) == 0)
+	    return -1;
+	slot %= n;
+	for (cpu = 0; !CPU_ISSET(cpu, &set) || slot-- > 0; cpu++)
+	    ;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	return -1;
+    return cpu;
+}
+
+/*
+ * shared_calloc - calloc for results that -j workers fill in. With 
+ *     more than one job the memory is a shared mapping, so that the
+ *     parent sees what its workers write. It is never freed.
+ */
+static void *shared_calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (jobs == 1)
+	return calloc(nmemb, size);
+    p = mmap(NULL, nmemb * size, PROT_READ | PROT_WRITE, 
+	     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+
+/*
+ * fork_worker - start a worker process for the next trace once one of 
+ *     the -j slots is idle. Returns the worker's slot in the worker and
+ *     -1 in the parent, which goes on to the next trace.
+ */
+static int fork_worker(void)
+{
+    int slot;
+    pid_t pid;
+
+    for (;;) {
+	for (slot = 0; slot < jobs && workers[slot] != 0; slot++)
+	    ;
+	if (slot < jobs)
+	    break;
+	wait_worker();
+    }
+
+    fflush(stdout); /* or the worker would print it again */
+    if ((pid = fork()) < 0)
+	unix_error("fork failed in fork_worker");
+    if (pid == 0) {
+	errors = 0; /* the parent already counted its earlier workers' */
+	return slot;
+    }
+    workers[slot] = pid;
+    return -1;
+}
+
+/*
+ * worker_exit - end a worker process, passing its error count to the 
+ *     parent as the exit status
+ */
+static void worker_exit(void)
+{
+    exit(errors < 255 ? errors : 255);
+}
+
+/*
+ * wait_worker - wait for one worker process to finish and add its 
+ *     errors to ours. A worker that dies of a signal or calls app_error 
+ *     counts as at least one error.
+ */
+static void wait_worker(void)
+{
+    int status, slot;
+    pid_t pid;
+
+    if ((pid = wait(&status)) < 0)
+	unix_error("wait failed in wait_worker");
+    for (slot = 0; slot < jobs; slot++)
+	if (workers[slot] == pid)
+	    workers[slot] = 0;
+    if (WIFEXITED(status))
+	errors += WEXITSTATUS(status);
+    else
+	errors++;
+}
+
+/*
+ * wait_workers - wait until every worker process has finished
+ */
+static void wait_workers(void)
+{
+    int slot;
+
+    for (slot = 0; slot < jobs; slot++)
+	while (workers != NULL && workers[slot] != 0)
+	    wait_worker();
+}
+
+/*
+ * cmp_double - qsort comparison function for doubles
+ */
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -1004,14 +2248,23 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValL] [-f <file>] [-t <dir>] [-T <n>]\n"
+	    "               [-B <runs> [-J <file>]] [-F <n>] [-j <n>]\n"
+	    "               [-C <n>[,<level>]]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
+    fprintf(stderr, "\t-B <runs>  Time each trace <runs> times, report the spread.\n");
+    fprintf(stderr, "\t-C <n>[,<level>] Run mm_checkheap(<level>) every <n> requests.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-F <n>     Profile the heap layout every <n> requests.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-j <n>     Evaluate up to <n> traces at once.\n");
+    fprintf(stderr, "\t-J <file>  Also write the -B results to <file> as JSON.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-L         Report per-request latency percentiles.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-T <n>     Also replay each trace with 1, 2, 4, ... n threads.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
 }
@@ -1,8 +1,28 @@
 /*
- * memlib.c - a module that simulates the memory system.  Needed because it 
- *            allows us to interleave calls from the student's malloc package 
+ * memlib.c - a module that simulates the memory system.  Needed because it
+ *            allows us to interleave calls from the student's malloc package
  *            with the system's malloc package in libc.
+ *
+ *            mem_sbrk may be called from several threads at once, so a
+ *            multi-threaded malloc package can share one heap.
+ *
+ *            With USE_MMAP_HEAP (see config.h) the heap is a MAX_VHEAP
+ *            reservation of inaccessible pages. mem_sbrk makes pages
+ *            accessible as the heap grows and, given a negative
+ *            increment, returns the pages above the new brk to the
+ *            kernel. Otherwise the heap is a fixed MAX_HEAP block from
+ *            malloc and memory is never returned.
+ *
+ *            Large blocks may also be placed outside the heap, in
+ *            mappings of their own made with mem_map. The model keeps
+ *            a list of those mappings, counts them in the footprint,
+ *            and unmaps any that are left when the heap is reset.
+ *
+ *            mem_clean_lo tells a calloc how much of a block it must
+ *            zero: heap bytes at or above it have not been written
+ *            since the kernel last handed out their pages.
  */
+#define _GNU_SOURCE          /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -10,64 +30,312 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "memlib.h"
 #include "config.h"
 
+/* Pages are made accessible in units of this many bytes */
+#define COMMIT_UNIT (1<<16)
+
+/* A mapping made by mem_map */
+typedef struct mapping {
+    char *addr;
+    size_t size;
+    struct mapping *next;
+} mapping_t;
+
 /* private variables */
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
-static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_max_addr;   /* largest legal heap address */
+static char *mem_dirty;      /* heap bytes from here up are still zero */
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER; /* guards mem_brk */
+#if USE_MMAP_HEAP
+static char *mem_commit_brk; /* end of the accessible part of the heap */
+#endif
+static size_t mem_peak_size; /* largest footprint since the last reset */
+static size_t mem_peak_rss;  /* largest resident size seen since the reset */
+static int mem_sampling;     /* sample the resident size before pages leave */
+static mapping_t *mem_maps;  /* mappings made by mem_map, newest first */
+static size_t mem_mapped;    /* total size of those mappings */
 
-/* 
+static size_t resident_bytes(char *lo, char *hi);
+static size_t footprint(void);
+static mapping_t **find_mapping(char *addr);
+static void unmap_all(void);
+#if USE_MMAP_HEAP
+static void decommit(char *addr);
+#endif
+
+/*
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
+#if USE_MMAP_HEAP
+    /* reserve address space for the heap without backing it yet */
+    mem_start_brk = mmap(NULL, HEAP_LIMIT, PROT_NONE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem_start_brk == MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
+	exit(1);
+    }
+    mem_commit_brk = mem_start_brk;
+    mem_dirty = mem_start_brk;
+#else
     /* allocate the storage we will use to model the available VM */
     if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
 	fprintf(stderr, "mem_init_vm: malloc error\n");
 	exit(1);
     }
+#endif
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
-    mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_max_addr = mem_start_brk + HEAP_LIMIT; /* max legal heap address */
+#if !USE_MMAP_HEAP
+    mem_dirty = mem_max_addr;                  /* malloc does not zero it */
+#endif
+    mem_brk = mem_start_brk;                   /* heap is empty initially */
+    mem_peak_size = mem_peak_rss = 0;
 }
 
-/* 
+/*
  * mem_deinit - free the storage used by the memory system model
  */
 void mem_deinit(void)
 {
+    unmap_all();
+#if USE_MMAP_HEAP
+    munmap(mem_start_brk, HEAP_LIMIT);
+#else
     free(mem_start_brk);
+#endif
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap.
+ *    Pages that were already touched stay accessible, so resetting is
+ *    cheap enough to do inside a timed run. Mappings still left from
+ *    mem_map are unmapped.
  */
 void mem_reset_brk()
 {
+    unmap_all();
     mem_brk = mem_start_brk;
+    mem_peak_size = mem_peak_rss = 0;
 }
 
-/* 
- * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+/*
+ * mem_release - reset the heap like mem_reset_brk and also return all of
+ *    its pages to the kernel, so that the next run starts with no
+ *    resident heap pages.
  */
-void *mem_sbrk(int incr) 
+void mem_release()
 {
-    char *old_brk = mem_brk;
+#if USE_MMAP_HEAP
+    decommit(mem_start_brk);
+#endif
+    mem_reset_brk();
+}
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+/*
+ * mem_sbrk - simple model of the sbrk function. Extends the heap
+ *    by incr bytes and returns the start address of the new area.
+ *    A negative incr shrinks the heap; with USE_MMAP_HEAP the whole
+ *    pages above the new brk are given back to the kernel.
+ */
+void *mem_sbrk(int incr)
+{
+    char *old_brk;
+#if USE_MMAP_HEAP
+    char *commit;
+#endif
+
+    pthread_mutex_lock(&mem_lock);
+    old_brk = mem_brk;
+    if ((mem_brk + incr) > mem_max_addr || (mem_brk + incr) < mem_start_brk) {
+	pthread_mutex_unlock(&mem_lock);
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
     mem_brk += incr;
+
+#if USE_MMAP_HEAP
+    if (mem_brk > mem_commit_brk) {
+	/* make the pages up to the new brk accessible */
+	commit = mem_start_brk + ((mem_brk - mem_start_brk + COMMIT_UNIT - 1)
+				  & ~(size_t)(COMMIT_UNIT - 1));
+	if (commit > mem_max_addr)
+	    commit = mem_max_addr;
+	if (mprotect(mem_commit_brk, commit - mem_commit_brk,
+		     PROT_READ | PROT_WRITE) < 0) {
+	    mem_brk = old_brk;
+	    pthread_mutex_unlock(&mem_lock);
+	    fprintf(stderr, "ERROR: mem_sbrk failed. mprotect: %s\n",
+		    strerror(errno));
+	    return (void *)-1;
+	}
+	mem_commit_brk = commit;
+    }
+    else if (incr < 0) {
+	decommit(mem_brk);
+    }
+    if (mem_brk > mem_dirty)
+	mem_dirty = mem_brk;
+#endif
+
+    if (footprint() > mem_peak_size)
+	mem_peak_size = footprint();
+    pthread_mutex_unlock(&mem_lock);
     return (void *)old_brk;
 }
 
+/*
+ * mem_map - map size bytes of fresh, zeroed memory outside the heap,
+ *    starting on a page boundary. Returns NULL if the mapping fails.
+ */
+void *mem_map(size_t size)
+{
+    mapping_t *m;
+    char *addr;
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+	return NULL;
+    if ((m = (mapping_t *)malloc(sizeof(mapping_t))) == NULL) {
+	munmap(addr, size);
+	return NULL;
+    }
+    m->addr = addr;
+    m->size = size;
+
+    pthread_mutex_lock(&mem_lock);
+    m->next = mem_maps;
+    mem_maps = m;
+    mem_mapped += size;
+    if (footprint() > mem_peak_size)
+	mem_peak_size = footprint();
+    pthread_mutex_unlock(&mem_lock);
+    return addr;
+}
+
+/*
+ * mem_unmap - unmap a mapping made by mem_map
+ */
+void mem_unmap(void *addr)
+{
+    mapping_t **mp, *m;
+    size_t rss;
+
+    pthread_mutex_lock(&mem_lock);
+    if ((mp = find_mapping(addr)) == NULL) {
+	pthread_mutex_unlock(&mem_lock);
+	fprintf(stderr, "ERROR: mem_unmap: %p is not a mapping\n", addr);
+	return;
+    }
+    m = *mp;
+    *mp = m->next;
+
+    /* its pages are about to leave memory, so record the peak first */
+    if (mem_sampling) {
+	rss = mem_resident() + resident_bytes(m->addr, m->addr + m->size);
+	if (rss > mem_peak_rss)
+	    mem_peak_rss = rss;
+    }
+    mem_mapped -= m->size;
+    pthread_mutex_unlock(&mem_lock);
+
+    munmap(m->addr, m->size);
+    free(m);
+}
+
+/*
+ * mem_remap - resize a mapping made by mem_map to size bytes, moving
+ *    it if it cannot grow where it is. The pages are moved, not copied.
+ *    Returns the new address, or NULL if the mapping is unchanged
+ *    because it could not be resized.
+ */
+void *mem_remap(void *addr, size_t size)
+{
+    mapping_t **mp, *m;
+    char *newaddr;
+    size_t rss;
+
+    pthread_mutex_lock(&mem_lock);
+    if ((mp = find_mapping(addr)) == NULL) {
+	pthread_mutex_unlock(&mem_lock);
+	fprintf(stderr, "ERROR: mem_remap: %p is not a mapping\n", addr);
+	return NULL;
+    }
+    m = *mp;
+    if (size < m->size && mem_sampling) {
+	rss = mem_resident();
+	if (rss > mem_peak_rss)
+	    mem_peak_rss = rss;
+    }
+    newaddr = mremap(m->addr, m->size, size, MREMAP_MAYMOVE);
+    if (newaddr == MAP_FAILED) {
+	pthread_mutex_unlock(&mem_lock);
+	return NULL;
+    }
+    mem_mapped += size - m->size;
+    m->addr = newaddr;
+    m->size = size;
+    if (footprint() > mem_peak_size)
+	mem_peak_size = footprint();
+    pthread_mutex_unlock(&mem_lock);
+    return newaddr;
+}
+
+/*
+ * mem_is_mapped - is [lo, hi] inside a single mapping made by mem_map?
+ */
+int mem_is_mapped(void *lo, void *hi)
+{
+    mapping_t *m;
+    int found = 0;
+
+    pthread_mutex_lock(&mem_lock);
+    for (m = mem_maps; m != NULL; m = m->next) {
+	if ((char *)lo >= m->addr && (char *)hi < m->addr + m->size) {
+	    found = 1;
+	    break;
+	}
+    }
+    pthread_mutex_unlock(&mem_lock);
+    return found;
+}
+
+/*
+ * mem_clean_lo - return the lowest heap address from which on the heap
+ *    is known to hold only zeros. Pages stay dirty when mem_reset_brk
+ *    empties the heap, and only pages given back to the kernel by
+ *    mem_sbrk or mem_release become clean again.
+ */
+void *mem_clean_lo()
+{
+    char *clean;
+
+    pthread_mutex_lock(&mem_lock);
+    clean = mem_dirty;
+    pthread_mutex_unlock(&mem_lock);
+    return (void *)clean;
+}
+
+/*
+ * mem_sample_resident - turn on or off sampling the resident size just
+ *    before pages leave memory. A sample runs mincore over the whole
+ *    heap, so it is only turned on for runs that are not timed.
+ */
+void mem_sample_resident(int on)
+{
+    pthread_mutex_lock(&mem_lock);
+    mem_sampling = on;
+    pthread_mutex_unlock(&mem_lock);
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -76,7 +344,7 @@ void *mem_heap_lo()
     return (void *)mem_start_brk;
 }
 
-/* 
+/*
  * mem_heap_hi - return address of last heap byte
  */
 void *mem_heap_hi()
@@ -87,7 +355,7 @@ void *mem_heap_hi()
 /*
  * mem_heapsize() - returns the heap size in bytes
  */
-size_t mem_heapsize() 
+size_t mem_heapsize()
 {
     return (size_t)(mem_brk - mem_start_brk);
 }
@@ -99,3 +367,138 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * mem_peak_heapsize() - returns the largest footprint, the heap size
+ *    plus the size of the mappings, since the last reset. This is the
+ *    high water mark even if the heap was shrunk or mappings unmapped.
+ */
+size_t mem_peak_heapsize()
+{
+    return mem_peak_size;
+}
+
+/*
+ * mem_resident() - returns the number of heap and mapping bytes that
+ *    currently occupy physical memory
+ */
+size_t mem_resident()
+{
+    mapping_t *m;
+    size_t rss;
+
+#if USE_MMAP_HEAP
+    rss = resident_bytes(mem_start_brk, mem_commit_brk);
+#else
+    rss = resident_bytes(mem_start_brk, mem_brk);
+#endif
+    for (m = mem_maps; m != NULL; m = m->next)
+	rss += resident_bytes(m->addr, m->addr + m->size);
+    return rss;
+}
+
+/*
+ * mem_peak_resident() - returns the largest resident heap size since the
+ *    last reset. Heap pages only leave memory when mem_sbrk gives them
+ *    back, and while sampling is on it samples the resident size just
+ *    before it does, so the peak is exact without sampling after every
+ *    request.
+ */
+size_t mem_peak_resident()
+{
+    size_t rss = mem_resident();
+
+    if (rss > mem_peak_rss)
+	mem_peak_rss = rss;
+    return mem_peak_rss;
+}
+
+/*
+ * resident_bytes - count the resident bytes of the pages in [lo, hi)
+ */
+static size_t resident_bytes(char *lo, char *hi)
+{
+    size_t pagesize = mem_pagesize();
+    char *start = (char *)((size_t)lo & ~(pagesize - 1));
+    size_t npages, i, count = 0;
+    unsigned char *vec;
+
+    if (hi <= lo)
+	return 0;
+    npages = (hi - start + pagesize - 1) / pagesize;
+    if ((vec = (unsigned char *)malloc(npages)) == NULL)
+	return 0;
+    if (mincore(start, npages * pagesize, (void *)vec) == 0) {
+	for (i = 0; i < npages; i++)
+	    count += vec[i] & 1;
+    }
+    free(vec);
+    return count * pagesize;
+}
+
+/*
+ * footprint - the heap size plus the size of the mappings
+ */
+static size_t footprint(void)
+{
+    return (size_t)(mem_brk - mem_start_brk) + mem_mapped;
+}
+
+/*
+ * find_mapping - return the link that points to the mapping at addr,
+ *    or NULL if there is none
+ */
+static mapping_t **find_mapping(char *addr)
+{
+    mapping_t **mp;
+
+    for (mp = &mem_maps; *mp != NULL; mp = &(*mp)->next)
+	if ((*mp)->addr == addr)
+	    return mp;
+    return NULL;
+}
+
+/*
+ * unmap_all - unmap every mapping made by mem_map
+ */
+static void unmap_all(void)
+{
+    mapping_t *m;
+
+    while ((m = mem_maps) != NULL) {
+	mem_maps = m->next;
+	munmap(m->addr, m->size);
+	free(m);
+    }
+    mem_mapped = 0;
+}
+
+#if USE_MMAP_HEAP
+/*
+ * decommit - give the whole pages between addr and the end of the
+ *    accessible heap back to the kernel and make them inaccessible again
+ */
+static void decommit(char *addr)
+{
+    size_t pagesize = mem_pagesize();
+    char *start = mem_start_brk +
+	((addr - mem_start_brk + pagesize - 1) & ~(pagesize - 1));
+    size_t rss;
+
+    if (start >= mem_commit_brk)
+	return;
+
+    /* these pages are about to leave memory, so record the peak first */
+    if (mem_sampling) {
+	rss = resident_bytes(mem_start_brk, mem_commit_brk);
+	if (rss > mem_peak_rss)
+	    mem_peak_rss = rss;
+    }
+
+    madvise(start, mem_commit_brk - start, MADV_DONTNEED);
+    mprotect(start, mem_commit_brk - start, PROT_NONE);
+    mem_commit_brk = start;
+    if (mem_dirty > start)
+	mem_dirty = start;   /* the kernel zeroes the pages it takes back */
+}
+#endif
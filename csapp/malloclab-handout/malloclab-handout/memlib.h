@@ -3,9 +3,19 @@
 void mem_init(void);               
 void mem_deinit(void);
 void *mem_sbrk(int incr);
+void *mem_map(size_t size);
+void mem_unmap(void *addr);
+void *mem_remap(void *addr, size_t size);
+int mem_is_mapped(void *lo, void *hi);
 void mem_reset_brk(void); 
+void mem_release(void);
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_clean_lo(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
+size_t mem_peak_heapsize(void);
+size_t mem_resident(void);
+size_t mem_peak_resident(void);
+void mem_sample_resident(int on);
 
@@ -0,0 +1,183 @@
+/*
+ * mm-naive.c - The fastest, least memory-efficient malloc package.
+ * 
+ * In this naive approach, a block is allocated by simply incrementing
+ * the brk pointer.  A block is pure payload. There are no headers or
+ * footers.  Blocks are never coalesced or reused. Realloc is
+ * implemented directly using mm_malloc and mm_free.
+ *
+ * This is the reference package that mm.c is measured against. Build
+ * it with "make mdriver-naive".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+/*********************************************************
+ * NOTE TO STUDENTS: Before you do anything else, please
+ * provide your team information in the following struct.
+ ********************************************************/
+team_t team = {
+    /* Team name */
+    "ateam",
+    /* First member's full name */
+    "Harry Bovik",
+    /* First member's email address */
+    "bovik@cs.cmu.edu",
+    /* Second member's full name (leave blank if none) */
+    "",
+    /* Second member's email address (leave blank if none) */
+    ""
+};
+
+/* single word (4) or double word (8) alignment */
+#define ALIGNMENT 8
+
+/* rounds up to the nearest multiple of ALIGNMENT */
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~0x7)
+
+
+#define SIZE_T_SIZE (ALIGN(sizeof(size_t)))
+
+/* The brk pointer is bumped without any locking */
+const int mm_thread_safe = 0;
+
+/* Blocks are not sorted by size at all */
+const int mm_num_classes = 1;
+
+/* 
+ * mm_init - initialize the malloc package.
+ */
+int mm_init(void)
+{
+    return 0;
+}
+
+/* 
+ * mm_malloc - Allocate a block by incrementing the brk pointer.
+ *     Always allocate a block whose size is a multiple of the alignment.
+ */
+void *mm_malloc(size_t size)
+{
+    int newsize = ALIGN(size + SIZE_T_SIZE);
+    void *p = mem_sbrk(newsize);
+    if (p == (void *)-1)
+	return NULL;
+    else {
+        *(size_t *)p = size;
+        return (void *)((char *)p + SIZE_T_SIZE);
+    }
+}
+
+/*
+ * mm_free - Freeing a block does nothing.
+ */
+void mm_free(void *ptr)
+{
+}
+
+/*
+ * mm_realloc - Implemented simply in terms of mm_malloc and mm_free
+ */
+void *mm_realloc(void *ptr, size_t size)
+{
+    void *oldptr = ptr;
+    void *newptr;
+    size_t copySize;
+    
+    newptr = mm_malloc(size);
+    if (newptr == NULL)
+      return NULL;
+    copySize = *(size_t *)((char *)oldptr - SIZE_T_SIZE);
+    if (size < copySize)
+      copySize = size;
+    memcpy(newptr, oldptr, copySize);
+    mm_free(oldptr);
+    return newptr;
+}
+
+/*
+ * mm_calloc - mm_malloc followed by a memset
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (nmemb != 0 && size > (size_t)-1 / nmemb)
+	return NULL;
+    if ((p = mm_malloc(nmemb * size)) != NULL)
+	memset(p, 0, nmemb * size);
+    return p;
+}
+
+/*
+ * mm_memalign - Pad the heap with an empty block, if need be, so that
+ *     the payload of the next block lands on a multiple of alignment.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    size_t payload, gap;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+	return NULL;
+    payload = (size_t)mem_heap_hi() + 1 + SIZE_T_SIZE;
+    gap = ((payload + alignment - 1) & ~(alignment - 1)) - payload;
+    if (gap != 0 && mm_malloc(gap - SIZE_T_SIZE) == NULL)
+	return NULL;
+    return mm_malloc(size);
+}
+
+/*
+ * mm_malloc_usable_size - The payload runs up to the next block
+ */
+size_t mm_malloc_usable_size(void *ptr)
+{
+    if (ptr == NULL)
+	return 0;
+    return ALIGN(*(size_t *)((char *)ptr - SIZE_T_SIZE) + SIZE_T_SIZE) -
+	SIZE_T_SIZE;
+}
+
+/*
+ * mm_heap_walk - Every block ever allocated is still in the heap and,
+ *     since mm_free does nothing, is reported as allocated.
+ */
+void mm_heap_walk(void (*fn)(const mm_block_t *block, void *arg), void *arg)
+{
+    char *p = mem_heap_lo();
+    char *end = (char *)mem_heap_hi() + 1;
+    mm_block_t block;
+
+    for (; p < end; p += block.size) {
+	block.payload = p + SIZE_T_SIZE;
+	block.size = ALIGN(*(size_t *)p + SIZE_T_SIZE);
+	block.overhead = SIZE_T_SIZE;
+	block.allocated = 1;
+	block.size_class = 0;
+	fn(&block, arg);
+    }
+}
+
+/*
+ * mm_checkheap - The blocks only have to tile the heap exactly.
+ */
+int mm_checkheap(int level)
+{
+    char *p = mem_heap_lo();
+    char *end = (char *)mem_heap_hi() + 1;
+
+    if (level < 1)
+	return 0;
+    while (p < end)
+	p += ALIGN(*(size_t *)p + SIZE_T_SIZE);
+    if (p != end) {
+	fprintf(stderr, "mm_checkheap: last block runs past the heap\n");
+	return 1;
+    }
+    return 0;
+}
@@ -1,22 +1,112 @@
 /*
- * mm-naive.c - The fastest, least memory-efficient malloc package.
- * 
- * In this naive approach, a block is allocated by simply incrementing
- * the brk pointer.  A block is pure payload. There are no headers or
- * footers.  Blocks are never coalesced or reused. Realloc is
- * implemented directly using mm_malloc and mm_free.
+ * mm.c - Segregated-fit malloc package with boundary-tag coalescing.
  *
- * NOTE TO STUDENTS: Replace this header comment with your own header
- * comment that gives a high level description of your solution.
+ * Every block carries a one-word header and a one-word footer holding
+ * the block size and an allocated bit. Block sizes are multiples of
+ * the alignment, so the low three bits of a tag are free for flags.
+ *
+ *      allocated block              free block
+ *   +------------------+       +------------------+
+ *   | size       |  1  |       | size       |  0  |  header
+ *   +------------------+       +------------------+
+ *   |                  |       | pred offset      |
+ *   |     payload      |       | succ offset      |
+ *   |                  |       | (unused)         |
+ *   +------------------+       +------------------+
+ *   | size       |  1  |       | size       |  0  |  footer
+ *   +------------------+       +------------------+
+ *
+ * Free blocks are kept on NUM_CLASSES segregated lists. List i holds
+ * blocks whose size lies in [2^(i+4), 2^(i+5)), the last list holds
+ * everything larger. Each list is ordered by size, so the first block
+ * that fits in a list is also the best fit in that list. The links are
+ * stored as word-sized offsets from the start of the heap, which keeps
+ * the minimum block at 16 bytes on both 32-bit and 64-bit builds.
+ *
+ * Free blocks are coalesced with their neighbors immediately. The heap
+ * starts with a prologue block and ends with a zero-sized epilogue
+ * header, so coalescing never has to special-case the heap edges. When
+ * a free block of TRIM_THRESHOLD bytes or more ends up at the top of
+ * the heap, all but TRIM_KEEP bytes of it are returned with a negative
+ * mem_sbrk.
+ *
+ * Requests of MMAP_THRESHOLD bytes or more bypass the heap. Each gets
+ * a page-aligned mapping of its own from mem_map, with a small header
+ * that records the mapping size and links the huge blocks together for
+ * mm_heap_walk. Freeing one unmaps it, and realloc resizes the mapping
+ * with mem_remap, which moves pages instead of copying bytes. Huge
+ * blocks are told apart from heap blocks by their address alone.
+ *
+ * mm_memalign carves an aligned block out of a free block with room to
+ * spare and frees the gap in front of it, so the gap is reused like any
+ * other free block. A huge block is aligned by moving its payload
+ * within the mapping; the word just before every huge payload holds
+ * the payload's offset from the start of the mapping. mm_calloc only
+ * zeroes the bytes below mem_clean_lo, since memory that the heap has
+ * never used before comes zeroed from the kernel.
+ *
+ * The free lists live in an arena. Normally there is a single arena
+ * that owns the whole heap. When compiled with -DMM_ARENAS (see the
+ * mdriver-mt target) the package is thread-safe instead:
+ *
+ *   - There are NUM_ARENAS arenas, each with its own lock. Threads are
+ *     assigned to arenas round robin on their first request.
+ *   - Arenas take heap space from mem_sbrk in ARENA_CHUNK multiples.
+ *     Each such span is framed by its own prologue and epilogue, so
+ *     blocks are never coalesced across arenas. A byte map records
+ *     which arena owns each chunk, so any thread can free any block.
+ *   - Each thread caches freed blocks of up to TCACHE_MAXSIZE bytes in
+ *     per-size bins that need no locking. Cached blocks stay marked as
+ *     allocated. An empty bin is refilled with TCACHE_BATCH blocks
+ *     under a single arena lock.
+ *
+ * When compiled with -DMM_SLAB (see the mdriver-slab target) requests
+ * of up to SLAB_MAXSIZE bytes are served by a slab layer instead:
+ *
+ *   - A slab is a SLAB_SIZE page cut into equal objects of one size,
+ *     a multiple of the alignment. Objects have no header; a header at
+ *     the start of the slab holds the object size and an intrusive list
+ *     of the free objects. Each object size has a list of the slabs
+ *     that still have free objects.
+ *   - Slabs are cut SLAB_BATCH at a time from one ordinary block, the
+ *     slab's chunk, and are aligned to SLAB_SIZE from the heap base. A
+ *     bit map over the heap pages tells mm_free and mm_realloc whether
+ *     a pointer is a slab object.
+ *   - Empty slabs can be reused for any object size. Once all slabs of
+ *     a chunk are empty and other empty slabs remain, the chunk is freed
+ *     back to the ordinary heap.
+ *
+ * mm_checkheap checks the heap structure in every build. Compiling with
+ * -DMM_DEBUG (see the mdriver-debug target) hardens the package so that
+ * corruption is caught where it happens instead of much later:
+ *
+ *   - Each heap block ends with a canary word just before its footer,
+ *     derived from the block address and a per-heap key. It is checked
+ *     when the block is freed or reallocated and by mm_checkheap, and
+ *     is inverted on free, so a second free of the block is recognized.
+ *   - Free-list links are stored XORed with the key, and every decoded
+ *     link must point into the heap, so a payload write through a
+ *     dangling pointer cannot silently redirect the allocator.
+ *   - Detected corruption is reported on stderr and aborts the program.
+ *
+ * Without MM_DEBUG the canary takes no space and the key is the
+ * constant 0, so release builds do no extra work.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#ifdef MM_DEBUG
+#include <time.h>
+#endif
+#ifdef MM_ARENAS
+#include <pthread.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
+#include "config.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -41,70 +131,1558 @@ team_t team = {
 /* rounds up to the nearest multiple of ALIGNMENT */
 #define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~0x7)
 
+/* Basic constants */
+#define WSIZE       4       /* word and header/footer size (bytes) */
+#define DSIZE       8       /* double word size (bytes) */
+#define MINBLOCK    16      /* header + two links + footer */
+#define NUM_CLASSES 20      /* number of segregated free lists */
+#define TRIM_THRESHOLD (1<<18) /* give back a free heap top this large... */
+#define TRIM_KEEP   (1<<16)    /* ...except for this many bytes */
+#ifndef MMAP_THRESHOLD
+#define MMAP_THRESHOLD (1<<17) /* requests this large get their own mapping */
+#endif
+
+/* Multi-arena constants (only used with -DMM_ARENAS) */
+#define NUM_ARENAS     4          /* number of independently locked arenas */
+#define ARENA_CHUNK    (1<<16)    /* arenas take heap space in 64 KB units */
+#define MAX_CHUNKS     (HEAP_LIMIT / ARENA_CHUNK)
+#define TCACHE_MAXSIZE 256        /* largest block size kept in a thread cache */
+#define TCACHE_BINS    (TCACHE_MAXSIZE / ALIGNMENT - 1)
+#define TCACHE_COUNT   16         /* max blocks per thread cache bin */
+#define TCACHE_BATCH   8          /* blocks taken from an arena per refill */
+
+/* Slab constants (only used with -DMM_SLAB) */
+#ifndef SLAB_MAXSIZE
+#define SLAB_MAXSIZE   128        /* largest request served from a slab */
+#endif
+#define SLAB_SIZE      4096       /* bytes per slab, a power of 2 */
+#define SLAB_BATCH     8          /* slabs cut from each chunk */
+#define SLAB_CLASSES   (SLAB_MAXSIZE / ALIGNMENT)
+#define MAX_SLAB_PAGES (HEAP_LIMIT / SLAB_SIZE)
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+
+/* Pack a size and allocated bit into a word */
+#define PACK(size, alloc)  ((size) | (alloc))
+
+/* Read and write a word at address p */
+#define GET(p)       (*(unsigned int *)(p))
+#define PUT(p, val)  (*(unsigned int *)(p) = (unsigned int)(val))
+
+/* Read the size and allocated fields from address p */
+#define GET_SIZE(p)  (GET(p) & ~0x7)
+#define GET_ALLOC(p) (GET(p) & 0x1)
+
+/* Given block ptr bp, compute address of its header and footer */
+#define HDRP(bp)     ((char *)(bp) - WSIZE)
+#define FTRP(bp)     ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
+
+/* Given block ptr bp, compute address of next and previous blocks */
+#define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(HDRP(bp)))
+#define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE((char *)(bp) - DSIZE))
+
+/* Debug mode: canaries and encoded links (see the comment at the top) */
+#ifdef MM_DEBUG
+#define CANARY_SIZE   WSIZE
+#define CANARYP(bp)   (FTRP(bp) - WSIZE)
+#define CANARY(bp)    ((unsigned int)(size_t)(bp) ^ link_key)
+#define SET_CANARY(bp) PUT(CANARYP(bp), CANARY(bp))
+#define LINK_KEY      link_key
+#else
+#define CANARY_SIZE   0
+#define SET_CANARY(bp)
+#define LINK_KEY      0
+#endif
+
+/* Encode or decode a pointer-sized free-list link */
+#define MANGLE(p)     ((char *)((size_t)(p) ^ LINK_KEY))
+
+/* Free-list links, stored as encoded offsets from the heap base (0 is NULL) */
+#define TO_OFF(bp)    (((bp) ? (unsigned int)((char *)(bp) - heap_base) : 0) ^ \
+		       LINK_KEY)
+#ifdef MM_DEBUG
+#define TO_PTR(off)   decode_link(off)
+#else
+#define TO_PTR(off)   ((off) ? heap_base + (off) : NULL)
+#endif
+#define PRED(bp)      TO_PTR(GET(bp))
+#define SUCC(bp)      TO_PTR(GET((char *)(bp) + WSIZE))
+#define SET_PRED(bp, p) PUT(bp, TO_OFF(p))
+#define SET_SUCC(bp, p) PUT((char *)(bp) + WSIZE, TO_OFF(p))
+
+/* Header at the start of the mapping of a huge block */
+typedef struct huge {
+    struct huge *next;                /* neighbors on the huge block list */
+    struct huge *prev;
+    size_t size;                      /* size of the whole mapping */
+    size_t offset;                    /* payload offset, for mm_heap_walk */
+} huge_t;
+
+/* The word before a huge payload holds its offset in the mapping. The
+   payload of an unaligned huge block follows the header, so that word
+   is the header's offset field. */
+#define HUGE_HDR      ALIGN(sizeof(huge_t))
+#define HUGE_OFFSET(bp) (((size_t *)(bp))[-1])
+#define HUGE_OF(bp)   ((huge_t *)((char *)(bp) - HUGE_OFFSET(bp)))
+#define IS_HUGE(bp)   ((size_t)((char *)(bp) - heap_base) >= HEAP_LIMIT)
 
-#define SIZE_T_SIZE (ALIGN(sizeof(size_t)))
+/* A set of segregated free lists and the heap space they manage */
+typedef struct {
+#ifdef MM_ARENAS
+    pthread_mutex_t lock;             /* protects everything below */
+    char *end;                        /* first byte past the last span */
+#endif
+    char *seg_lists[NUM_CLASSES];     /* heads of the segregated lists */
+} arena_t;
 
-/* 
+#ifdef MM_ARENAS
+#define LOCK(a)   pthread_mutex_lock(&(a)->lock)
+#define UNLOCK(a) pthread_mutex_unlock(&(a)->lock)
+#define HUGE_LOCK()   pthread_mutex_lock(&huge_lock)
+#define HUGE_UNLOCK() pthread_mutex_unlock(&huge_lock)
+
+/* Per-thread cache of freed blocks, one LIFO bin per block size */
+typedef struct {
+    unsigned int gen;                 /* heap generation the cache is for */
+    arena_t *arena;                   /* arena this thread allocates from */
+    char *bins[TCACHE_BINS];          /* linked through the first payload word */
+    int count[TCACHE_BINS];
+} tcache_t;
+
+#define TC_BIN(asize)  ((asize) / ALIGNMENT - 2)
+#define TC_NEXT(bp)    (*(char **)(bp))
+
+const int mm_thread_safe = 1;
+#else
+#define LOCK(a)
+#define UNLOCK(a)
+#define HUGE_LOCK()
+#define HUGE_UNLOCK()
+
+const int mm_thread_safe = 0;
+#endif
+
+#ifdef MM_SLAB
+#ifdef MM_ARENAS
+#error "MM_SLAB and MM_ARENAS cannot be combined"
+#endif
+
+/* Header at the start of every slab */
+typedef struct slab {
+    struct slab *next;                /* neighbors on a partial or empty list */
+    struct slab *prev;
+    char *free;                       /* free objects, linked through word 0 */
+    char *bump;                       /* first object never handed out */
+    char *chunk;                      /* payload of the block it was cut from */
+    unsigned int size;                /* object size, 0 while empty */
+    unsigned int used;                /* objects handed out */
+} slab_t;
+
+#define SLAB_OBJS(s)   ((char *)(s) + ALIGN(sizeof(slab_t)))
+#define SLAB_END(s)    ((char *)(s) + SLAB_SIZE)
+#define SLAB_OF(bp)    ((slab_t *)(heap_base + \
+			((char *)(bp) - heap_base) / SLAB_SIZE * SLAB_SIZE))
+#define SLAB_PAGE(bp)  (((char *)(bp) - heap_base) / SLAB_SIZE)
+#define OBJ_NEXT(bp)   (*(char **)(bp))
+#define CHUNK_LIVE(c)  GET(c)          /* number of non-empty slabs in chunk c */
+#endif
+
+const int mm_num_classes = NUM_CLASSES;
+
+/* Global variables */
+static char *heap_base;               /* first byte of the heap */
+static char *heap_listp;              /* pointer to the prologue block */
+#ifdef MM_DEBUG
+static unsigned int link_key;         /* encodes links and canaries */
+#endif
+static huge_t *huge_list;             /* huge blocks, newest first */
+#ifdef MM_ARENAS
+static pthread_mutex_t huge_lock = PTHREAD_MUTEX_INITIALIZER; /* guards huge_list */
+static char *first_span;              /* where the first arena span starts */
+static arena_t arenas[NUM_ARENAS];
+static unsigned char chunk_owner[MAX_CHUNKS]; /* arena index of each chunk */
+static unsigned int heap_gen;         /* bumped by every mm_init */
+static unsigned int next_arena;       /* round-robin arena assignment */
+static pthread_key_t tcache_key;      /* runs tcache_flush at thread exit */
+static __thread tcache_t tcache;
+#else
+static arena_t main_arena;
+#endif
+#ifdef MM_SLAB
+static slab_t *partial[SLAB_CLASSES]; /* slabs with free objects, by size */
+static slab_t *empty_slabs;           /* slabs with no objects handed out */
+static int num_empty;                 /* number of slabs on that list */
+static unsigned char slab_pages[MAX_SLAB_PAGES / 8]; /* bit per slab page */
+#endif
+
+/* Function prototypes for internal helper routines */
+static void *arena_malloc(arena_t *a, size_t asize);
+static void *arena_memalign(arena_t *a, size_t align, size_t asize);
+static void arena_free(arena_t *a, void *bp);
+static int resize_block(arena_t *a, void *bp, size_t asize);
+static void *extend_heap(arena_t *a, size_t asize);
+static void *coalesce(arena_t *a, void *bp);
+static void *find_fit(arena_t *a, size_t asize);
+static void place(arena_t *a, void *bp, size_t asize);
+static void split_tail(arena_t *a, void *bp, size_t asize);
+static void release_block(arena_t *a, void *bp);
+static int size_class(size_t asize);
+static void insert_block(arena_t *a, void *bp);
+static void remove_block(arena_t *a, void *bp);
+static size_t adjust_size(size_t size);
+static char *walk_span(char *bp, void (*fn)(const mm_block_t *, void *),
+		       void *arg);
+static void *huge_malloc(size_t size, size_t align);
+static void huge_free(void *bp);
+static void *huge_realloc(void *bp, size_t size);
+static size_t huge_size(size_t size);
+static char *check_span(char *bp, size_t *nfree, int *errs);
+static int check_lists(arena_t *a, size_t *nlisted);
+static int check_huge(void);
+static int heap_error(char *msg, void *bp);
+#ifdef MM_DEBUG
+static char *decode_link(unsigned int off);
+static void check_block(void *bp);
+static void corrupt(char *msg, void *bp);
+#endif
+#ifdef MM_ARENAS
+static arena_t *thread_arena(void);
+static arena_t *owner_arena(void *bp);
+static void *pool_alloc(arena_t *a, size_t incr);
+static void *tcache_malloc(arena_t *a, size_t asize);
+static int tcache_free(void *bp);
+static void tcache_flush(void *unused);
+#endif
+#ifdef MM_SLAB
+static int is_slab(void *bp);
+static void *slab_malloc(size_t size);
+static void slab_free(void *bp);
+static slab_t *new_slab(size_t size);
+static int new_chunk(void);
+static void free_chunk(char *chunk);
+static void slab_push(slab_t **list, slab_t *s);
+static void slab_unlink(slab_t **list, slab_t *s);
+static int check_slabs(void);
+#endif
+
+/*
  * mm_init - initialize the malloc package.
  */
 int mm_init(void)
 {
+    int i;
+#ifdef MM_ARENAS
+    static int initialized = 0;
+    size_t pad;
+#endif
+
+    huge_list = NULL;   /* resetting the heap unmapped the huge blocks */
+#ifdef MM_DEBUG
+    link_key = (unsigned int)time(NULL) * 2654435761u ^ (unsigned int)getpid();
+#endif
+#ifdef MM_ARENAS
+
+    if (!initialized) {
+	for (i = 0; i < NUM_ARENAS; i++)
+	    pthread_mutex_init(&arenas[i].lock, NULL);
+	pthread_key_create(&tcache_key, tcache_flush);
+	initialized = 1;
+    }
+
+    /* Start the first span on a chunk boundary */
+    heap_base = mem_heap_lo();
+    pad = (ARENA_CHUNK - mem_heapsize() % ARENA_CHUNK) % ARENA_CHUNK;
+    if (pad != 0 && mem_sbrk(pad) == (void *)-1)
+	return -1;
+    heap_listp = NULL;
+    first_span = (char *)mem_heap_hi() + 1;
+
+    for (i = 0; i < NUM_ARENAS; i++) {
+	arenas[i].end = NULL;
+	memset(arenas[i].seg_lists, 0, sizeof(arenas[i].seg_lists));
+    }
+    memset(chunk_owner, 0, sizeof(chunk_owner));
+    next_arena = 0;
+    heap_gen++;   /* invalidates every thread cache */
+#else
+    /* Create the initial empty heap */
+    if ((heap_listp = mem_sbrk(4*WSIZE)) == (void *)-1)
+	return -1;
+    heap_base = heap_listp;
+    PUT(heap_listp, 0);                            /* alignment padding */
+    PUT(heap_listp + (1*WSIZE), PACK(DSIZE, 1));   /* prologue header */
+    PUT(heap_listp + (2*WSIZE), PACK(DSIZE, 1));   /* prologue footer */
+    PUT(heap_listp + (3*WSIZE), PACK(0, 1));       /* epilogue header */
+    heap_listp += (2*WSIZE);
+
+    for (i = 0; i < NUM_CLASSES; i++)
+	main_arena.seg_lists[i] = NULL;
+#endif
+#ifdef MM_SLAB
+    memset(partial, 0, sizeof(partial));
+    memset(slab_pages, 0, sizeof(slab_pages));
+    empty_slabs = NULL;
+    num_empty = 0;
+#endif
     return 0;
 }
 
-/* 
- * mm_malloc - Allocate a block by incrementing the brk pointer.
- *     Always allocate a block whose size is a multiple of the alignment.
+/*
+ * mm_malloc - Allocate a block from the smallest size class that has
+ *     a fit, extending the heap only when no free block is large enough.
  */
 void *mm_malloc(size_t size)
 {
-    int newsize = ALIGN(size + SIZE_T_SIZE);
-    void *p = mem_sbrk(newsize);
-    if (p == (void *)-1)
+    size_t asize;
+    arena_t *a;
+    char *bp;
+
+    if (size == 0)
 	return NULL;
-    else {
-        *(size_t *)p = size;
-        return (void *)((char *)p + SIZE_T_SIZE);
-    }
+    if (size >= MMAP_THRESHOLD)
+	return huge_malloc(size, ALIGNMENT);
+#ifdef MM_SLAB
+    if (size <= SLAB_MAXSIZE)
+	return slab_malloc(ALIGN(size));
+#endif
+
+    asize = adjust_size(size);
+#ifdef MM_ARENAS
+    a = thread_arena();
+    if (asize <= TCACHE_MAXSIZE)
+	return tcache_malloc(a, asize);
+#else
+    a = &main_arena;
+#endif
+
+    LOCK(a);
+    bp = arena_malloc(a, asize);
+    UNLOCK(a);
+    return bp;
 }
 
 /*
- * mm_free - Freeing a block does nothing.
+ * mm_free - Free a block and merge it with any free neighbors.
  */
 void mm_free(void *ptr)
 {
+    arena_t *a;
+
+    if (ptr == NULL)
+	return;
+    if (IS_HUGE(ptr)) {
+	huge_free(ptr);
+	return;
+    }
+#ifdef MM_SLAB
+    if (is_slab(ptr)) {
+	slab_free(ptr);
+	return;
+    }
+#endif
+#ifdef MM_DEBUG
+    check_block(ptr);
+    PUT(CANARYP(ptr), ~CANARY(ptr));  /* a second free will see this */
+#endif
+
+#ifdef MM_ARENAS
+    if (tcache_free(ptr))
+	return;
+    a = owner_arena(ptr);
+#else
+    a = &main_arena;
+#endif
+
+    LOCK(a);
+    arena_free(a, ptr);
+    UNLOCK(a);
 }
 
 /*
- * mm_realloc - Implemented simply in terms of mm_malloc and mm_free
+ * mm_realloc - Resize a block in place whenever possible. Shrinking
+ *     splits off the tail, growing absorbs a free successor and, at the
+ *     end of the heap, extends the heap with mem_sbrk. Only when none of
+ *     those work is the payload copied to a new block, which is a huge
+ *     block if the new size calls for one. Huge blocks are remapped.
  */
 void *mm_realloc(void *ptr, size_t size)
 {
-    void *oldptr = ptr;
     void *newptr;
     size_t copySize;
-    
+    arena_t *a;
+    int resized;
+
+    if (ptr == NULL)
+	return mm_malloc(size);
+    if (size == 0) {
+	mm_free(ptr);
+	return NULL;
+    }
+    if (IS_HUGE(ptr)) {
+	if (size >= MMAP_THRESHOLD)
+	    return huge_realloc(ptr, size);
+	if ((newptr = mm_malloc(size)) == NULL)
+	    return NULL;
+	memcpy(newptr, ptr, size);
+	huge_free(ptr);
+	return newptr;
+    }
+#ifdef MM_SLAB
+    /* A slab object keeps its slot as long as the new size fits */
+    if (is_slab(ptr)) {
+	copySize = SLAB_OF(ptr)->size;
+	if (size <= copySize)
+	    return ptr;
+	if ((newptr = mm_malloc(size)) == NULL)
+	    return NULL;
+	memcpy(newptr, ptr, copySize);
+	slab_free(ptr);
+	return newptr;
+    }
+#endif
+
+#ifdef MM_DEBUG
+    check_block(ptr);
+#endif
+
+#ifdef MM_ARENAS
+    a = owner_arena(ptr);
+#else
+    a = &main_arena;
+#endif
+    LOCK(a);
+    resized = resize_block(a, ptr, adjust_size(size));
+    UNLOCK(a);
+    if (resized) {
+	SET_CANARY(ptr);
+	return ptr;
+    }
+
     newptr = mm_malloc(size);
     if (newptr == NULL)
-      return NULL;
-    copySize = *(size_t *)((char *)oldptr - SIZE_T_SIZE);
+	return NULL;
+    copySize = GET_SIZE(HDRP(ptr)) - DSIZE - CANARY_SIZE;
     if (size < copySize)
-      copySize = size;
-    memcpy(newptr, oldptr, copySize);
-    mm_free(oldptr);
+	copySize = size;
+    memcpy(newptr, ptr, copySize);
+    mm_free(ptr);
     return newptr;
 }
 
+/*
+ * mm_calloc - Allocate a zeroed block for nmemb objects of size bytes.
+ *     Huge blocks are fresh mappings and need no zeroing at all. A heap
+ *     block is zeroed only below mem_clean_lo, read before the block is
+ *     allocated: whatever extend_heap added above it is untouched memory,
+ *     except for the free-list links in the first two payload words.
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+    size_t total, dirty;
+    arena_t *a;
+    char *bp, *clean;
 
+    if (nmemb != 0 && size > (size_t)-1 / nmemb)
+	return NULL;
+    total = nmemb * size;
+    if (total == 0)
+	return NULL;
+    if (total >= MMAP_THRESHOLD)
+	return huge_malloc(total, ALIGNMENT);
+#ifdef MM_SLAB
+    if (total <= SLAB_MAXSIZE) {
+	if ((bp = slab_malloc(ALIGN(total))) != NULL)
+	    memset(bp, 0, total);
+	return bp;
+    }
+#endif
 
+#ifdef MM_ARENAS
+    a = thread_arena();
+    if (adjust_size(total) <= TCACHE_MAXSIZE) {
+	if ((bp = tcache_malloc(a, adjust_size(total))) != NULL)
+	    memset(bp, 0, total);
+	return bp;
+    }
+#else
+    a = &main_arena;
+#endif
 
+    LOCK(a);
+    clean = mem_clean_lo();
+    bp = arena_malloc(a, adjust_size(total));
+    UNLOCK(a);
+    if (bp == NULL)
+	return NULL;
 
+    /* Zero what lies below the clean mark, and the links in any case */
+    dirty = (clean > bp) ? (size_t)(clean - bp) : 0;
+    memset(bp, 0, MIN(total, MAX(dirty, 2*WSIZE)));
+    return bp;
+}
 
+/*
+ * mm_memalign - Allocate a block of size bytes whose address is a
+ *     multiple of alignment, a power of 2. Every block is aligned to
+ *     ALIGNMENT anyway. Slab objects are not aligned any further, so
+ *     the slab layer is bypassed, as is the thread cache.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    arena_t *a;
+    char *bp;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+	return NULL;
+    if (size == 0 || size + alignment < size)
+	return NULL;
+    if (alignment <= ALIGNMENT)
+	return mm_malloc(size);
+    if (size >= MMAP_THRESHOLD || alignment >= MMAP_THRESHOLD)
+	return huge_malloc(size, alignment);
+
+#ifdef MM_ARENAS
+    a = thread_arena();
+#else
+    a = &main_arena;
+#endif
+    LOCK(a);
+    bp = arena_memalign(a, alignment, adjust_size(size));
+    UNLOCK(a);
+    return bp;
+}
+
+/*
+ * mm_malloc_usable_size - Return the number of payload bytes of block
+ *     ptr, or 0 if ptr is NULL.
+ */
+size_t mm_malloc_usable_size(void *ptr)
+{
+    huge_t *h;
 
+    if (ptr == NULL)
+	return 0;
+    if (IS_HUGE(ptr)) {
+	h = HUGE_OF(ptr);
+	return h->size - h->offset;
+    }
+#ifdef MM_SLAB
+    if (is_slab(ptr))
+	return SLAB_OF(ptr)->size;
+#endif
+    return GET_SIZE(HDRP(ptr)) - DSIZE - CANARY_SIZE;
+}
 
+/*
+ * mm_heap_walk - Report every block of the heap to fn, in address 
+ *     order. With arenas, all arena locks are held during the walk and
+ *     the spans are walked one after the other. Blocks sitting in a 
+ *     thread cache are reported as allocated, which is what they are
+ *     to the arenas. With slabs, each chunk of slabs is reported as one
+ *     allocated block. The huge blocks follow the heap, newest first.
+ */
+void mm_heap_walk(void (*fn)(const mm_block_t *block, void *arg), void *arg)
+{
+    mm_block_t block;
+    huge_t *h;
+#ifdef MM_ARENAS
+    char *span, *end;
+    int i;
 
+    for (i = 0; i < NUM_ARENAS; i++)
+	LOCK(&arenas[i]);
+    end = (char *)mem_heap_hi() + 1;
+    span = first_span;
+    while (span < end)
+	span = walk_span(span + 4*WSIZE, fn, arg);
+    for (i = NUM_ARENAS - 1; i >= 0; i--)
+	UNLOCK(&arenas[i]);
+#else
+    walk_span(NEXT_BLKP(heap_listp), fn, arg);
+#endif
 
+    HUGE_LOCK();
+    for (h = huge_list; h != NULL; h = h->next) {
+	block.payload = (char *)h + h->offset;
+	block.size = h->size;
+	block.overhead = h->offset;
+	block.allocated = 1;
+	block.size_class = NUM_CLASSES - 1;
+	fn(&block, arg);
+    }
+    HUGE_UNLOCK();
+}
 
+/*
+ * mm_checkheap - Check the heap for consistency and print each problem
+ *     found to stderr. Level 1 checks every block: alignment, size,
+ *     matching header and footer, no two free blocks in a row, and the
+ *     list of huge blocks. Level 2 also checks that the free lists hold
+ *     exactly the free blocks, each on the list for its size and in
+ *     size order. Debug builds check the canaries of allocated blocks
+ *     as well, except with arenas, where a block in a thread cache has
+ *     its canary overwritten. Returns the number of problems found.
+ */
+int mm_checkheap(int level)
+{
+    size_t nfree = 0, nlisted = 0;
+    int errs = 0;
+    char *bp;
+#ifdef MM_ARENAS
+    char *end;
+    int i;
+#endif
 
+    if (level < 1)
+	return 0;
 
+#ifdef MM_ARENAS
+    for (i = 0; i < NUM_ARENAS; i++)
+	LOCK(&arenas[i]);
+    end = (char *)mem_heap_hi() + 1;
+    for (bp = first_span; bp != NULL && bp < end; ) {
+	if (GET(bp + WSIZE) != PACK(DSIZE, 1) || 
+	    GET(bp + 2*WSIZE) != PACK(DSIZE, 1))
+	    errs += heap_error("bad prologue", bp + 2*WSIZE);
+	bp = check_span(bp + 4*WSIZE, &nfree, &errs);
+    }
+    if (level >= 2) {
+	for (i = 0; i < NUM_ARENAS; i++)
+	    errs += check_lists(&arenas[i], &nlisted);
+    }
+    for (i = NUM_ARENAS - 1; i >= 0; i--)
+	UNLOCK(&arenas[i]);
+#else
+    if (GET(HDRP(heap_listp)) != PACK(DSIZE, 1) ||
+	GET(FTRP(heap_listp)) != PACK(DSIZE, 1))
+	errs += heap_error("bad prologue", heap_listp);
+    bp = check_span(NEXT_BLKP(heap_listp), &nfree, &errs);
+    if (bp != NULL && HDRP(bp) != (char *)mem_heap_hi() + 1 - WSIZE)
+	errs += heap_error("epilogue is not at the end of the heap", bp);
+    if (level >= 2)
+	errs += check_lists(&main_arena, &nlisted);
+#endif
+    if (level >= 2 && nlisted != nfree)
+	errs += heap_error("free lists and heap disagree on the number "
+			   "of free blocks", NULL);
 
+    errs += check_huge();
+#ifdef MM_SLAB
+    if (level >= 2)
+	errs += check_slabs();
+#endif
+    return errs;
+}
+
+/*********************************
+ * The remaining routines are internal helper routines
+ *********************************/
+
+/*
+ * walk_span - Report the blocks from bp up to the next epilogue to fn
+ *     and return the address just past that epilogue.
+ */
+static char *walk_span(char *bp, void (*fn)(const mm_block_t *, void *),
+		       void *arg)
+{
+    mm_block_t block;
+
+    for (; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+	block.payload = bp;
+	block.size = GET_SIZE(HDRP(bp));
+	block.overhead = DSIZE + CANARY_SIZE;
+	block.allocated = GET_ALLOC(HDRP(bp));
+	block.size_class = size_class(block.size);
+	fn(&block, arg);
+    }
+    return bp;
+}
+
+/*
+ * check_span - Check the blocks from bp up to the next epilogue, count
+ *     the free ones in *nfree and add the problems found to *errs.
+ *     Returns the address just past the epilogue, or NULL if a block
+ *     is too damaged to walk past.
+ */
+static char *check_span(char *bp, size_t *nfree, int *errs)
+{
+    char *end = (char *)mem_heap_hi() + 1;
+    size_t size;
+    int prev_free = 0;
+
+    for (; (size = GET_SIZE(HDRP(bp))) > 0; bp = NEXT_BLKP(bp)) {
+	if ((size_t)bp % ALIGNMENT != 0)
+	    *errs += heap_error("block is not aligned", bp);
+	if (size < MINBLOCK || bp + size > end) {
+	    *errs += heap_error("block has a bad size", bp);
+	    return NULL;
+	}
+	if (GET(HDRP(bp)) != GET(FTRP(bp)))
+	    *errs += heap_error("header and footer differ", bp);
+	if (!GET_ALLOC(HDRP(bp))) {
+	    if (prev_free)
+		*errs += heap_error("free block was not coalesced", bp);
+	    (*nfree)++;
+	}
+#if defined(MM_DEBUG) && !defined(MM_ARENAS)
+	else if (GET(CANARYP(bp)) != CANARY(bp))
+	    *errs += heap_error("canary overwritten", bp);
+#endif
+	prev_free = !GET_ALLOC(HDRP(bp));
+    }
+    return bp;
+}
+
+/*
+ * check_lists - Check the free lists of arena a and add the number of
+ *     blocks on them to *nlisted. Returns the number of problems.
+ */
+static int check_lists(arena_t *a, size_t *nlisted)
+{
+    size_t limit = mem_heapsize() / MINBLOCK;
+    char *bp, *prev;
+    int i, errs = 0;
+
+    for (i = 0; i < NUM_CLASSES; i++) {
+	prev = NULL;
+	for (bp = a->seg_lists[i]; bp != NULL; bp = SUCC(bp)) {
+	    if (bp < heap_base || bp > (char *)mem_heap_hi()) {
+		errs += heap_error("free list leaves the heap", bp);
+		break;
+	    }
+	    if (GET_ALLOC(HDRP(bp)))
+		errs += heap_error("allocated block on a free list", bp);
+	    if (size_class(GET_SIZE(HDRP(bp))) != i)
+		errs += heap_error("block on the wrong free list", bp);
+	    if (PRED(bp) != prev)
+		errs += heap_error("bad predecessor link", bp);
+	    if (prev != NULL && GET_SIZE(HDRP(prev)) > GET_SIZE(HDRP(bp)))
+		errs += heap_error("free list is out of size order", bp);
+	    if (++*nlisted > limit) {
+		errs += heap_error("free list has a cycle", bp);
+		break;
+	    }
+	    prev = bp;
+	}
+    }
+    return errs;
+}
+
+/*
+ * check_huge - Check the list of huge blocks. Returns the number of
+ *     problems.
+ */
+static int check_huge(void)
+{
+    huge_t *h;
+    int errs = 0;
+
+    HUGE_LOCK();
+    for (h = huge_list; h != NULL; h = h->next) {
+	if (h->size % mem_pagesize() != 0 ||
+	    !mem_is_mapped(h, (char *)h + h->size - 1))
+	    errs += heap_error("huge block is not a whole mapping", 
+			       (char *)h + h->offset);
+	else if (h->offset < HUGE_HDR || h->offset >= h->size ||
+		 HUGE_OFFSET((char *)h + h->offset) != h->offset)
+	    errs += heap_error("bad huge payload offset", (char *)h + h->offset);
+	if (h->next != NULL && h->next->prev != h)
+	    errs += heap_error("bad huge block link", (char *)h + h->offset);
+    }
+    HUGE_UNLOCK();
+    return errs;
+}
+
+/*
+ * heap_error - Report a problem found by mm_checkheap and return 1
+ */
+static int heap_error(char *msg, void *bp)
+{
+    fprintf(stderr, "mm_checkheap: %s (block %p)\n", msg, bp);
+    return 1;
+}
+
+#ifdef MM_DEBUG
+/*
+ * decode_link - Turn an encoded free-list offset back into a block
+ *     pointer, and stop if it does not point into the heap.
+ */
+static char *decode_link(unsigned int off)
+{
+    off ^= link_key;
+    if (off == 0)
+	return NULL;
+    if (off % ALIGNMENT != 0 || heap_base + off > (char *)mem_heap_hi())
+	corrupt("free-list link points outside the heap", heap_base + off);
+    return heap_base + off;
+}
+
+/*
+ * check_block - Check block bp as it is freed or reallocated
+ */
+static void check_block(void *bp)
+{
+    if (GET(HDRP(bp)) != GET(FTRP(bp)))
+	corrupt("header and footer differ", bp);
+    if (!GET_ALLOC(HDRP(bp)) || GET(CANARYP(bp)) == ~CANARY(bp))
+	corrupt("block freed twice", bp);
+    if (GET(CANARYP(bp)) != CANARY(bp))
+	corrupt("canary overwritten by a heap overflow", bp);
+}
+
+/*
+ * corrupt - Report heap corruption and abort
+ */
+static void corrupt(char *msg, void *bp)
+{
+    fprintf(stderr, "mm: heap corruption: %s (block %p)\n", msg, bp);
+    abort();
+}
+#endif
+
+/*
+ * huge_malloc - Give a request of size bytes a mapping of its own, with
+ *     the payload aligned to align. Mappings start on a page boundary,
+ *     so the payload moves within the mapping to reach the alignment.
+ */
+static void *huge_malloc(size_t size, size_t align)
+{
+    size_t len = huge_size(size + (align > ALIGNMENT ? align : 0));
+    huge_t *h;
+    char *bp;
+
+    if ((h = (huge_t *)mem_map(len)) == NULL)
+	return NULL;
+    bp = (char *)(((size_t)h + HUGE_HDR + align - 1) & ~(align - 1));
+    h->size = len;
+    h->offset = bp - (char *)h;
+    HUGE_OFFSET(bp) = h->offset;
+    h->prev = NULL;
+
+    HUGE_LOCK();
+    h->next = huge_list;
+    if (huge_list != NULL)
+	huge_list->prev = h;
+    huge_list = h;
+    HUGE_UNLOCK();
+    return bp;
+}
+
+/*
+ * huge_free - Unmap huge block bp.
+ */
+static void huge_free(void *bp)
+{
+    huge_t *h = HUGE_OF(bp);
+
+    HUGE_LOCK();
+    if (h->prev != NULL)
+	h->prev->next = h->next;
+    else
+	huge_list = h->next;
+    if (h->next != NULL)
+	h->next->prev = h->prev;
+    HUGE_UNLOCK();
+    mem_unmap(h);
+}
+
+/*
+ * huge_realloc - Resize the mapping of huge block bp to hold size
+ *     bytes. The kernel moves the pages if the mapping cannot grow in
+ *     place, so the payload is never copied. Returns NULL, leaving bp
+ *     alone, if the mapping cannot be resized.
+ */
+static void *huge_realloc(void *bp, size_t size)
+{
+    huge_t *h = HUGE_OF(bp);
+    size_t len = huge_size(size + h->offset - HUGE_HDR);
+
+    if (len == h->size)
+	return bp;
+
+    HUGE_LOCK();
+    if ((h = (huge_t *)mem_remap(h, len)) != NULL) {
+	/* The header moved along with the pages, so fix its neighbors */
+	h->size = len;
+	if (h->prev != NULL)
+	    h->prev->next = h;
+	else
+	    huge_list = h;
+	if (h->next != NULL)
+	    h->next->prev = h;
+    }
+    HUGE_UNLOCK();
+    return (h != NULL) ? (char *)h + h->offset : NULL;
+}
+
+/*
+ * huge_size - Size of the mapping for a huge request of size bytes:
+ *     room for the header, rounded up to whole pages.
+ */
+static size_t huge_size(size_t size)
+{
+    size_t pagesize = mem_pagesize();
+
+    return (size + HUGE_HDR + pagesize - 1) & ~(pagesize - 1);
+}
+
+/*
+ * adjust_size - Round a request up to a legal block size that has room
+ *     for the header and footer (and the canary in debug builds).
+ */
+static size_t adjust_size(size_t size)
+{
+    return MAX(MINBLOCK, ALIGN(size + DSIZE + CANARY_SIZE));
+}
+
+/*
+ * arena_malloc - Allocate a block of asize bytes from arena a
+ */
+static void *arena_malloc(arena_t *a, size_t asize)
+{
+    char *bp;
+
+    if ((bp = find_fit(a, asize)) == NULL) {
+	if ((bp = extend_heap(a, asize)) == NULL)
+	    return NULL;
+    }
+    place(a, bp, asize);
+    SET_CANARY(bp);
+    return bp;
+}
+
+/*
+ * arena_memalign - Allocate a block of asize bytes from arena a whose
+ *     payload is a multiple of align. The block is taken from one with
+ *     room for the worst-case gap in front of the aligned payload, and
+ *     the gap and any tail are freed again. The gap is either empty or
+ *     large enough to be a free block.
+ */
+static void *arena_memalign(arena_t *a, size_t align, size_t asize)
+{
+    char *bp, *p;
+    size_t size, gap;
+
+    if ((bp = arena_malloc(a, asize + align + MINBLOCK)) == NULL)
+	return NULL;
+    p = (char *)(((size_t)bp + align - 1) & ~(align - 1));
+    if (p != bp && p - bp < MINBLOCK)
+	p += align;
+
+    if (p != bp) {
+	size = GET_SIZE(HDRP(bp));
+	gap = p - bp;
+	PUT(HDRP(p), PACK(size - gap, 1));
+	PUT(FTRP(p), PACK(size - gap, 1));
+	PUT(HDRP(bp), PACK(gap, 0));
+	PUT(FTRP(bp), PACK(gap, 0));
+	release_block(a, bp);
+    }
+    split_tail(a, p, asize);
+    SET_CANARY(p);
+    return p;
+}
+
+/*
+ * arena_free - Return block bp to arena a
+ */
+static void arena_free(arena_t *a, void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+    release_block(a, bp);
+}
+
+/*
+ * release_block - Coalesce the newly freed block bp and put it on its
+ *     free list. A large enough free block at the top of the heap is
+ *     mostly given back to memlib instead. Arenas share the top of the
+ *     heap, so they never shrink it.
+ */
+static void release_block(arena_t *a, void *bp)
+{
+#ifndef MM_ARENAS
+    size_t size;
+#endif
+
+    bp = coalesce(a, bp);
+#ifndef MM_ARENAS
+    size = GET_SIZE(HDRP(bp));
+    if (size >= TRIM_THRESHOLD && GET_SIZE(HDRP(NEXT_BLKP(bp))) == 0) {
+	PUT(HDRP(bp), PACK(TRIM_KEEP, 0));
+	PUT(FTRP(bp), PACK(TRIM_KEEP, 0));
+	PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));  /* new epilogue header */
+	mem_sbrk(-(int)(size - TRIM_KEEP));
+    }
+#endif
+    insert_block(a, bp);
+}
+
+/*
+ * resize_block - Try to resize allocated block bp to asize bytes
+ *     without moving it. Returns 1 on success and 0 if the caller has
+ *     to move the payload.
+ */
+static int resize_block(arena_t *a, void *bp, size_t asize)
+{
+    size_t oldsize = GET_SIZE(HDRP(bp));
+    size_t nextsize;
+    char *next;
+
+    /* Shrink (or keep) the block and release the tail */
+    if (asize <= oldsize) {
+	split_tail(a, bp, asize);
+	return 1;
+    }
+
+    /* Grow into the next block if it is free and large enough */
+    next = NEXT_BLKP(bp);
+    nextsize = GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next));
+    if (oldsize + nextsize >= asize) {
+	remove_block(a, next);
+	PUT(HDRP(bp), PACK(oldsize + nextsize, 1));
+	PUT(FTRP(bp), PACK(oldsize + nextsize, 1));
+	split_tail(a, bp, asize);
+	return 1;
+    }
+
+#ifndef MM_ARENAS
+    /*
+     * Grow past the end of the heap if only free space follows. Arenas
+     * share the top of the heap, so they never take this path.
+     */
+    if (nextsize != 0)
+	next = NEXT_BLKP(next);
+    if (GET_SIZE(HDRP(next)) == 0) {
+	if (mem_sbrk(asize - oldsize - nextsize) == (void *)-1)
+	    return 0;
+	if (nextsize != 0)
+	    remove_block(a, NEXT_BLKP(bp));
+	PUT(HDRP(bp), PACK(asize, 1));
+	PUT(FTRP(bp), PACK(asize, 1));
+	PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));  /* new epilogue header */
+	return 1;
+    }
+#endif
+    return 0;
+}
+
+/*
+ * extend_heap - Grow the heap so that a free block of at least asize
+ *     bytes ends at the epilogue, put it on its free list and return
+ *     it. If the last block is already free, only the missing bytes
+ *     are requested.
+ *
+ *     With arenas, a whole number of chunks is requested instead. If the
+ *     new space directly follows the arena's last span, the old epilogue
+ *     becomes the header of the new block just as above. Otherwise the
+ *     space becomes a new span with its own prologue and epilogue.
+ */
+static void *extend_heap(arena_t *a, size_t asize)
+{
+    char *bp;
+    size_t size;
+#ifdef MM_ARENAS
+    size_t incr = (asize + 4*WSIZE + ARENA_CHUNK - 1) & ~(ARENA_CHUNK - 1);
+
+    if ((bp = pool_alloc(a, incr)) == NULL)
+	return NULL;
+    size = incr;
+    if (bp != a->end) {
+	PUT(bp, 0);                                /* alignment padding */
+	PUT(bp + (1*WSIZE), PACK(DSIZE, 1));       /* prologue header */
+	PUT(bp + (2*WSIZE), PACK(DSIZE, 1));       /* prologue footer */
+	bp += 4*WSIZE;
+	size -= 4*WSIZE;
+    }
+    a->end = bp + size;
+#else
+    char *epilogue = (char *)mem_heap_hi() + 1 - WSIZE;
+
+    size = asize;
+    if (!GET_ALLOC(epilogue - WSIZE))
+	size -= GET_SIZE(epilogue - WSIZE);
+
+    if ((long)(bp = mem_sbrk(size)) == -1)
+	return NULL;
+#endif
+
+    /* Initialize free block header/footer and the epilogue header */
+    PUT(HDRP(bp), PACK(size, 0));          /* free block header */
+    PUT(FTRP(bp), PACK(size, 0));          /* free block footer */
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));  /* new epilogue header */
+
+    /* Coalesce if the previous block was free */
+    bp = coalesce(a, bp);
+    insert_block(a, bp);
+    return bp;
+}
+
+/*
+ * coalesce - Boundary tag coalescing. The neighbors that get merged
+ *     are taken off their free lists; the caller decides what to do
+ *     with the resulting block. Returns ptr to the coalesced block.
+ */
+static void *coalesce(arena_t *a, void *bp)
+{
+    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if (!next_alloc) {
+	remove_block(a, NEXT_BLKP(bp));
+	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+	PUT(HDRP(bp), PACK(size, 0));
+	PUT(FTRP(bp), PACK(size, 0));
+    }
+    if (!prev_alloc) {
+	remove_block(a, PREV_BLKP(bp));
+	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
+	PUT(FTRP(bp), PACK(size, 0));
+	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+	bp = PREV_BLKP(bp);
+    }
+    return bp;
+}
+
+/*
+ * find_fit - Find a fit for a block with asize bytes, starting with the
+ *     list for its size class and moving on to larger classes.
+ */
+static void *find_fit(arena_t *a, size_t asize)
+{
+    int i;
+    char *bp;
+
+    for (i = size_class(asize); i < NUM_CLASSES; i++) {
+	for (bp = a->seg_lists[i]; bp != NULL; bp = SUCC(bp)) {
+	    if (asize <= GET_SIZE(HDRP(bp)))
+		return bp;
+	}
+    }
+    return NULL; /* No fit */
+}
+
+/*
+ * place - Place block of asize bytes at start of free block bp
+ *     and split if remainder would be at least minimum block size
+ */
+static void place(arena_t *a, void *bp, size_t asize)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+
+    remove_block(a, bp);
+    if ((csize - asize) >= MINBLOCK) {
+	PUT(HDRP(bp), PACK(asize, 1));
+	PUT(FTRP(bp), PACK(asize, 1));
+	bp = NEXT_BLKP(bp);
+	PUT(HDRP(bp), PACK(csize-asize, 0));
+	PUT(FTRP(bp), PACK(csize-asize, 0));
+	insert_block(a, bp);
+    }
+    else {
+	PUT(HDRP(bp), PACK(csize, 1));
+	PUT(FTRP(bp), PACK(csize, 1));
+    }
+}
+
+/*
+ * split_tail - Trim allocated block bp down to asize bytes and free the
+ *     tail, if the tail is large enough to be a block of its own.
+ */
+static void split_tail(arena_t *a, void *bp, size_t asize)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+    char *tail;
+
+    if ((csize - asize) < MINBLOCK)
+	return;
+    PUT(HDRP(bp), PACK(asize, 1));
+    PUT(FTRP(bp), PACK(asize, 1));
+    tail = NEXT_BLKP(bp);
+    PUT(HDRP(tail), PACK(csize-asize, 0));
+    PUT(FTRP(tail), PACK(csize-asize, 0));
+    release_block(a, tail);
+}
+
+/*
+ * size_class - Map a block size to the index of its segregated list
+ */
+static int size_class(size_t asize)
+{
+    int i = 0;
+
+    asize >>= 5;
+    while (asize != 0 && i < NUM_CLASSES - 1) {
+	asize >>= 1;
+	i++;
+    }
+    return i;
+}
+
+/*
+ * insert_block - Insert free block bp into its list, keeping the list
+ *     sorted by increasing size.
+ */
+static void insert_block(arena_t *a, void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    int i = size_class(size);
+    char *prev = NULL;
+    char *next = a->seg_lists[i];
+
+    while (next != NULL && GET_SIZE(HDRP(next)) < size) {
+	prev = next;
+	next = SUCC(next);
+    }
+
+    SET_PRED(bp, prev);
+    SET_SUCC(bp, next);
+    if (next != NULL)
+	SET_PRED(next, bp);
+    if (prev != NULL)
+	SET_SUCC(prev, bp);
+    else
+	a->seg_lists[i] = bp;
+}
+
+/*
+ * remove_block - Unlink free block bp from its list
+ */
+static void remove_block(arena_t *a, void *bp)
+{
+    char *prev = PRED(bp);
+    char *next = SUCC(bp);
+
+    if (prev != NULL)
+	SET_SUCC(prev, next);
+    else
+	a->seg_lists[size_class(GET_SIZE(HDRP(bp)))] = next;
+    if (next != NULL)
+	SET_PRED(next, prev);
+}
+
+#ifdef MM_ARENAS
+/*
+ * thread_arena - Return the calling thread's arena. The first request a
+ *     thread makes after mm_init picks an arena and empties its cache.
+ */
+static arena_t *thread_arena(void)
+{
+    if (tcache.gen != heap_gen) {
+	memset(&tcache, 0, sizeof(tcache));
+	tcache.gen = heap_gen;
+	tcache.arena = &arenas[__sync_fetch_and_add(&next_arena, 1) % NUM_ARENAS];
+	pthread_setspecific(tcache_key, &tcache);
+    }
+    return tcache.arena;
+}
+
+/*
+ * owner_arena - Return the arena whose span contains block bp
+ */
+static arena_t *owner_arena(void *bp)
+{
+    return &arenas[chunk_owner[((char *)bp - heap_base) / ARENA_CHUNK]];
+}
+
+/*
+ * pool_alloc - Take incr bytes (a multiple of ARENA_CHUNK) from the
+ *     shared heap for arena a. mem_sbrk serializes concurrent callers.
+ */
+static void *pool_alloc(arena_t *a, size_t incr)
+{
+    char *p;
+    size_t i;
+
+    if ((p = mem_sbrk(incr)) == (void *)-1)
+	return NULL;
+    for (i = 0; i < incr / ARENA_CHUNK; i++)
+	chunk_owner[(p - heap_base) / ARENA_CHUNK + i] = a - arenas;
+    return p;
+}
+
+/*
+ * tcache_malloc - Allocate a small block from the thread cache,
+ *     refilling the bin from arena a when it is empty.
+ */
+static void *tcache_malloc(arena_t *a, size_t asize)
+{
+    int bin = TC_BIN(asize);
+    char *bp;
+
+    if (tcache.bins[bin] == NULL) {
+	LOCK(a);
+	while (tcache.count[bin] < TCACHE_BATCH) {
+	    if ((bp = arena_malloc(a, asize)) == NULL)
+		break;
+	    /* place() hands out the whole block if the rest is too small */
+	    if (GET_SIZE(HDRP(bp)) != asize) {
+		if (tcache.count[bin] == 0) {
+		    UNLOCK(a);
+		    return bp;
+		}
+		arena_free(a, bp);
+		break;
+	    }
+	    TC_NEXT(bp) = MANGLE(tcache.bins[bin]);
+	    tcache.bins[bin] = bp;
+	    tcache.count[bin]++;
+	}
+	UNLOCK(a);
+	if (tcache.bins[bin] == NULL)
+	    return NULL;
+    }
+
+    bp = tcache.bins[bin];
+    tcache.bins[bin] = MANGLE(TC_NEXT(bp));
+    tcache.count[bin]--;
+    SET_CANARY(bp);
+    return bp;
+}
+
+/*
+ * tcache_free - Keep freed block bp in the thread cache if it is small
+ *     and its bin has room. Returns 0 if the block must go to its arena.
+ */
+static int tcache_free(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    int bin = TC_BIN(size);
+
+    if (size > TCACHE_MAXSIZE)
+	return 0;
+    thread_arena();
+    if (tcache.count[bin] >= TCACHE_COUNT)
+	return 0;
+    TC_NEXT(bp) = MANGLE(tcache.bins[bin]);
+    tcache.bins[bin] = bp;
+    tcache.count[bin]++;
+    return 1;
+}
+
+/*
+ * tcache_flush - Give the blocks cached by an exiting thread back to
+ *     the arenas that own them.
+ */
+static void tcache_flush(void *unused)
+{
+    int bin;
+    char *bp;
+    arena_t *a;
+
+    if (tcache.gen != heap_gen)
+	return;
+    for (bin = 0; bin < TCACHE_BINS; bin++) {
+	while ((bp = tcache.bins[bin]) != NULL) {
+	    tcache.bins[bin] = MANGLE(TC_NEXT(bp));
+	    a = owner_arena(bp);
+	    LOCK(a);
+	    arena_free(a, bp);
+	    UNLOCK(a);
+	}
+	tcache.count[bin] = 0;
+    }
+}
+#endif /* MM_ARENAS */
+
+#ifdef MM_SLAB
+/*
+ * is_slab - Is bp an object in a slab?
+ */
+static int is_slab(void *bp)
+{
+    size_t page = SLAB_PAGE(bp);
+
+    return (slab_pages[page / 8] >> (page % 8)) & 1;
+}
+
+/*
+ * slab_malloc - Hand out an object of size bytes (a multiple of the
+ *     alignment) from the first slab of that size with a free object.
+ */
+static void *slab_malloc(size_t size)
+{
+    slab_t *s = partial[size / ALIGNMENT - 1];
+    char *bp;
+
+    if (s == NULL && (s = new_slab(size)) == NULL)
+	return NULL;
+
+    if (s->free != NULL) {
+	bp = s->free;
+	s->free = MANGLE(OBJ_NEXT(bp));
+    }
+    else {
+	bp = s->bump;
+	s->bump += size;
+    }
+    s->used++;
+
+    /* A full slab leaves the partial list until an object comes back */
+    if (s->free == NULL && s->bump + size > SLAB_END(s))
+	slab_unlink(&partial[size / ALIGNMENT - 1], s);
+    return bp;
+}
+
+/*
+ * slab_free - Return object bp to its slab. A slab that becomes empty
+ *     goes to the empty list, and its chunk is freed if all of the
+ *     chunk's slabs are empty and there are other empty slabs to use.
+ */
+static void slab_free(void *bp)
+{
+    slab_t *s = SLAB_OF(bp);
+    slab_t **list = &partial[s->size / ALIGNMENT - 1];
+
+    if (s->free == NULL && s->bump + s->size > SLAB_END(s))
+	slab_push(list, s);  /* it was full */
+    OBJ_NEXT(bp) = MANGLE(s->free);
+    s->free = bp;
+    if (--s->used > 0)
+	return;
+
+    slab_unlink(list, s);
+    s->size = 0;
+    slab_push(&empty_slabs, s);
+    num_empty++;
+    if (--CHUNK_LIVE(s->chunk) == 0 && num_empty > SLAB_BATCH)
+	free_chunk(s->chunk);
+}
+
+/*
+ * new_slab - Set up an empty slab for objects of size bytes and put it 
+ *     on the partial list for that size. Returns NULL if the heap is 
+ *     exhausted.
+ */
+static slab_t *new_slab(size_t size)
+{
+    slab_t *s;
+
+    if (empty_slabs == NULL && !new_chunk())
+	return NULL;
+    s = empty_slabs;
+    slab_unlink(&empty_slabs, s);
+    num_empty--;
+    CHUNK_LIVE(s->chunk)++;
+
+    s->size = size;
+    s->used = 0;
+    s->free = NULL;
+    s->bump = SLAB_OBJS(s);
+    slab_push(&partial[size / ALIGNMENT - 1], s);
+    return s;
+}
+
+/*
+ * new_chunk - Allocate an ordinary block big enough for SLAB_BATCH 
+ *     aligned slabs plus the chunk's count of live slabs, and put the
+ *     slabs on the empty list. Returns 0 if the heap is exhausted.
+ */
+static int new_chunk(void)
+{
+    char *chunk, *base;
+    slab_t *s;
+    size_t page;
+    int i;
+
+    chunk = arena_malloc(&main_arena, 
+			 adjust_size((SLAB_BATCH + 1) * SLAB_SIZE + DSIZE));
+    if (chunk == NULL)
+	return 0;
+    CHUNK_LIVE(chunk) = 0;
+
+    /* The first SLAB_SIZE boundary past the count */
+    base = heap_base + (chunk + DSIZE - heap_base + SLAB_SIZE - 1) / 
+	SLAB_SIZE * SLAB_SIZE;
+    for (i = 0; i < SLAB_BATCH; i++) {
+	s = (slab_t *)(base + i * SLAB_SIZE);
+	s->chunk = chunk;
+	s->size = 0;
+	slab_push(&empty_slabs, s);
+	num_empty++;
+	page = SLAB_PAGE(s);
+	slab_pages[page / 8] |= 1 << (page % 8);
+    }
+    return 1;
+}
+
+/*
+ * free_chunk - Take the slabs of chunk, which are all empty, off the 
+ *     empty list and free the chunk's block.
+ */
+static void free_chunk(char *chunk)
+{
+    char *base;
+    slab_t *s;
+    size_t page;
+    int i;
+
+    base = heap_base + (chunk + DSIZE - heap_base + SLAB_SIZE - 1) / 
+	SLAB_SIZE * SLAB_SIZE;
+    for (i = 0; i < SLAB_BATCH; i++) {
+	s = (slab_t *)(base + i * SLAB_SIZE);
+	slab_unlink(&empty_slabs, s);
+	num_empty--;
+	page = SLAB_PAGE(s);
+	slab_pages[page / 8] &= ~(1 << (page % 8));
+    }
+    arena_free(&main_arena, chunk);
+}
+
+/*
+ * check_slabs - Check the partial and empty slab lists. Returns the
+ *     number of problems.
+ */
+static int check_slabs(void)
+{
+    slab_t *s;
+    int i, n, errs = 0;
+
+    for (i = 0; i < SLAB_CLASSES; i++) {
+	for (s = partial[i]; s != NULL; s = s->next) {
+	    if (!is_slab(s) || s->size != (i + 1) * ALIGNMENT)
+		errs += heap_error("bad slab on a partial list", s);
+	    else if (s->used == 0 || s->bump > SLAB_END(s))
+		errs += heap_error("bad object count in slab", s);
+	}
+    }
+    n = 0;
+    for (s = empty_slabs; s != NULL; s = s->next) {
+	if (!is_slab(s) || s->size != 0)
+	    errs += heap_error("bad slab on the empty list", s);
+	n++;
+    }
+    if (n != num_empty)
+	errs += heap_error("wrong number of empty slabs", NULL);
+    return errs;
+}
+
+/*
+ * slab_push - Put slab s at the front of list
+ */
+static void slab_push(slab_t **list, slab_t *s)
+{
+    s->prev = NULL;
+    s->next = *list;
+    if (*list != NULL)
+	(*list)->prev = s;
+    *list = s;
+}
+
+/*
+ * slab_unlink - Take slab s off list
+ */
+static void slab_unlink(slab_t **list, slab_t *s)
+{
+    if (s->prev != NULL)
+	s->prev->next = s->next;
+    else
+	*list = s->next;
+    if (s->next != NULL)
+	s->next->prev = s->prev;
+}
+#endif /* MM_SLAB */
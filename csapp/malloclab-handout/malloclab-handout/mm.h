@@ -5,6 +5,36 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 
+/* Allocate a zeroed block for nmemb objects of size bytes, or a block
+   whose address is a multiple of alignment (a power of 2). The usable
+   size of a block is its payload size, which may exceed the request. */
+extern void *mm_calloc(size_t nmemb, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern size_t mm_malloc_usable_size(void *ptr);
+
+/* Nonzero if the package may be called from several threads at once */
+extern const int mm_thread_safe;
+
+/* A block of the heap, as reported by mm_heap_walk */
+typedef struct {
+    void *payload;      /* address of the first payload byte */
+    size_t size;        /* size of the whole block in bytes */
+    size_t overhead;    /* bytes of the block taken by headers and footers */
+    int allocated;      /* zero if the package can hand the block out */
+    int size_class;     /* the package's size class for a block this size */
+} mm_block_t;
+
+/* Call fn(block, arg) for every block in the heap, in address order */
+extern void mm_heap_walk(void (*fn)(const mm_block_t *block, void *arg),
+			 void *arg);
+
+/* Size classes run from 0 to mm_num_classes - 1 */
+extern const int mm_num_classes;
+
+/* Check the heap at level 1 (blocks) or 2 (also free lists); returns
+   the number of problems found, each of which is printed to stderr */
+extern int mm_checkheap(int level);
+
 
 /* 
  * Students work in teams of one or two.  Teams enter their team name, 
@@ -0,0 +1,585 @@
+/*
+ * mmcapture.c - An LD_PRELOAD shim that records the malloc, calloc,
+ *     memalign, realloc and free calls of a running program as a
+ *     binary trace (see bintrace.h) that mdriver can replay:
+ *
+ *     unix> make mmcapture.so
+ *     unix> MMCAPTURE_PREFIX=ls LD_PRELOAD=./mmcapture.so ls -l
+ *     unix> mdriver -V -f ls.<pid>.bin
+ *
+ *     Each process writes its own <prefix>.<pid>.bin, where the prefix
+ *     defaults to "mmcapture", so that programs started by the traced
+ *     one do not write over its trace.
+ *
+ *     Pointers are mapped to dense block ids as the program runs: a
+ *     freed block's id is handed to the next allocation, so num_ids
+ *     stays close to the largest number of blocks live at once. Op
+ *     records are collected in a buffer and written out when it fills,
+ *     and the header is filled in when the program exits.
+ *
+ *     posix_memalign and aligned_alloc are recorded as memalign calls.
+ *     A block the trace never saw allocated (from valloc, before the
+ *     capture started, ...) is ignored when it is freed and becomes a
+ *     fresh allocation when it is realloced. A zero-byte request is not
+ *     recorded, since mdriver rejects zero-sized requests. A child that
+ *     forks without exec stops capturing.
+ *     Nothing is written if the program ends with _exit or a signal.
+ *
+ *     The shim itself never calls malloc: its tables live in pages from
+ *     mmap, and the calls that dlsym makes while the real functions are
+ *     being looked up are served from a small static pool.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "bintrace.h"
+
+#define BUF_OPS    (1<<16)   /* op records buffered between writes */
+#define MAP_INIT   (1<<16)   /* initial slots in the pointer map */
+#define IDS_INIT   (1<<14)   /* initial capacity of the free id stack */
+#define BOOT_BYTES 4096      /* static pool for dlsym's own allocations */
+
+/* Pointer map slot hash: drop the low alignment bits, then scramble */
+#define HASH(p, mask) \
+    ((size_t)((((unsigned long)(p)) >> 4) * 0x9e3779b97f4a7c15UL) & (mask))
+
+/* One slot of the open-addressing map from block address to block id */
+typedef struct {
+    void *ptr;               /* block address, or NULL if the slot is free */
+    size_t size;             /* requested size of the block */
+    int id;                  /* the block's id in the trace */
+} slot_t;
+
+/* The allocator that the shim forwards to */
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_memalign)(size_t, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+
+/* Serves the allocations dlsym makes before real_* are known */
+static char boot_pool[BOOT_BYTES];
+static size_t boot_used;
+static int resolving;
+
+/* Capture state, all guarded by lock */
+static pthread_mutex_t lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static int capturing;        /* set while the trace file is open */
+static int fd = -1;          /* the trace file */
+static bintrace_op_t buf[BUF_OPS]; /* records not yet written */
+static int nbuf;             /* number of records in buf */
+static slot_t *map;          /* block address -> id */
+static size_t map_size;      /* number of slots, a power of 2 */
+static size_t map_used;      /* number of occupied slots */
+static int *free_ids;        /* stack of ids whose blocks were freed */
+static int num_free_ids;     /* number of ids on the stack */
+static int max_free_ids;     /* capacity of the stack */
+static int next_id;          /* lowest id never handed out */
+static int num_ops;          /* op records written to the trace so far */
+static long live_bytes;      /* payload bytes currently allocated */
+static long peak_bytes;      /* largest value of live_bytes */
+
+/* Helper functions */
+static void resolve(void);
+static void *boot_alloc(size_t size);
+static int is_boot(void *p);
+static void record(int type, int index, int size, int align);
+static void flush_buf(void);
+static void track(void *p, size_t size, int type, size_t align);
+static int untrack(void *p);
+static slot_t *lookup(void *p);
+static void map_insert(void *p, size_t size, int id);
+static void map_delete(slot_t *s);
+static void map_grow(void);
+static void *pages(size_t bytes);
+static void stop_capture(void);
+static void atfork_prepare(void);
+static void atfork_parent(void);
+static void atfork_child(void);
+
+/*
+ * capture_init - open the trace file when the shim is loaded
+ */
+__attribute__((constructor))
+static void capture_init(void)
+{
+    char name[PATH_MAX];
+    char *prefix;
+    bintrace_hdr_t hdr;
+
+    resolve();
+
+    if ((prefix = getenv("MMCAPTURE_PREFIX")) == NULL)
+	prefix = "mmcapture";
+    snprintf(name, sizeof(name), "%s.%d.bin", prefix, (int)getpid());
+    if ((fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+	fprintf(stderr, "mmcapture: could not open %s\n", name);
+	return;
+    }
+
+    /* Leave room for the header, which is written at exit */
+    memset(&hdr, 0, sizeof(hdr));
+    map = pages(MAP_INIT * sizeof(slot_t));
+    free_ids = pages(IDS_INIT * sizeof(int));
+    if (map == NULL || free_ids == NULL ||
+	write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+	fprintf(stderr, "mmcapture: could not start the trace in %s\n", name);
+	close(fd);
+	fd = -1;
+	return;
+    }
+    map_size = MAP_INIT;
+    max_free_ids = IDS_INIT;
+
+    pthread_atfork(atfork_prepare, atfork_parent, atfork_child);
+    capturing = 1;
+}
+
+/*
+ * capture_fini - write out the buffered records and the header at exit
+ */
+__attribute__((destructor))
+static void capture_fini(void)
+{
+    bintrace_hdr_t hdr;
+
+    pthread_mutex_lock(&lock);
+    if (capturing) {
+	flush_buf();
+	hdr.magic = BINTRACE_MAGIC;
+	hdr.version = BINTRACE_VERSION;
+	hdr.sugg_heapsize = peak_bytes > INT_MAX ? INT_MAX : (int)peak_bytes;
+	hdr.num_ids = next_id;
+	hdr.num_ops = num_ops;
+	hdr.weight = 1;
+	if (pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+	    fprintf(stderr, "mmcapture: could not write the trace header\n");
+	stop_capture();
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/*********************************
+ * The interposed malloc functions
+ *********************************/
+
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (real_malloc == NULL) {
+	if (resolving)
+	    return boot_alloc(size);
+	resolve();
+    }
+    p = real_malloc(size);
+    if (p != NULL && size > 0) {
+	pthread_mutex_lock(&lock);
+	track(p, size, BINTRACE_ALLOC, 0);
+	pthread_mutex_unlock(&lock);
+    }
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (real_calloc == NULL) {
+	if (resolving)
+	    return boot_alloc(nmemb * size); /* the pool is already zero */
+	resolve();
+    }
+    p = real_calloc(nmemb, size);
+    if (p != NULL && nmemb > 0 && size > 0) {
+	pthread_mutex_lock(&lock);
+	track(p, nmemb * size, BINTRACE_CALLOC, 0);
+	pthread_mutex_unlock(&lock);
+    }
+    return p;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *p;
+
+    if (real_memalign == NULL) {
+	if (resolving)
+	    return NULL;
+	resolve();
+    }
+    p = real_memalign(alignment, size);
+    if (p != NULL && size > 0) {
+	pthread_mutex_lock(&lock);
+	track(p, size, BINTRACE_MEMALIGN, alignment);
+	pthread_mutex_unlock(&lock);
+    }
+    return p;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    int err;
+
+    if (real_posix_memalign == NULL) {
+	if (resolving)
+	    return ENOMEM;
+	resolve();
+    }
+    err = real_posix_memalign(memptr, alignment, size);
+    if (err == 0 && size > 0) {
+	pthread_mutex_lock(&lock);
+	track(*memptr, size, BINTRACE_MEMALIGN, alignment);
+	pthread_mutex_unlock(&lock);
+    }
+    return err;
+}
+
+/*
+ * realloc - the lock is held across the real call, so that no other
+ *     thread can be handed the old address before it is remapped. It
+ *     is recursive in case the real realloc calls malloc itself.
+ */
+void *realloc(void *ptr, size_t size)
+{
+    void *p;
+    slot_t *s;
+    size_t len;
+    int id;
+
+    if (ptr == NULL)
+	return malloc(size);
+    if (is_boot(ptr)) {
+	/* copy out of the pool; it never gives memory back */
+	len = boot_pool + BOOT_BYTES - (char *)ptr;
+	if ((p = malloc(size)) != NULL)
+	    memcpy(p, ptr, size < len ? size : len);
+	return p;
+    }
+    if (real_realloc == NULL)
+	resolve();
+
+    pthread_mutex_lock(&lock);
+    p = real_realloc(ptr, size);
+    if (size == 0) {
+	/* the block was freed, and any new one has zero bytes */
+	untrack(ptr);
+    }
+    else if (p != NULL) {
+	if (capturing && size <= INT_MAX && (s = lookup(ptr)) != NULL) {
+	    /* the block keeps its id wherever it ended up */
+	    id = s->id;
+	    live_bytes -= s->size;
+	    map_delete(s);
+	    map_insert(p, size, id);
+	    live_bytes += size;
+	    if (live_bytes > peak_bytes)
+		peak_bytes = live_bytes;
+	    record(BINTRACE_REALLOC, id, (int)size, 0);
+	}
+	else {
+	    untrack(ptr);
+	    track(p, size, BINTRACE_ALLOC, 0);
+	}
+    }
+    pthread_mutex_unlock(&lock);
+    return p;
+}
+
+/*
+ * free - the block is dropped from the trace before the real free, so
+ *     its address cannot be reused by another thread in the meantime
+ */
+void free(void *ptr)
+{
+    if (ptr == NULL || is_boot(ptr))
+	return;
+    if (real_free == NULL)
+	resolve();
+
+    pthread_mutex_lock(&lock);
+    untrack(ptr);
+    pthread_mutex_unlock(&lock);
+    real_free(ptr);
+}
+
+/*******************
+ * Helper functions
+ *******************/
+
+/*
+ * resolve - look up the allocator behind the shim
+ */
+static void resolve(void)
+{
+    resolving = 1;
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    resolving = 0;
+    if (!real_malloc || !real_calloc || !real_memalign || 
+	!real_posix_memalign || !real_realloc || !real_free) {
+	fprintf(stderr, "mmcapture: could not find the real malloc\n");
+	_exit(1);
+    }
+}
+
+/*
+ * boot_alloc - allocate from the static pool while resolving
+ */
+static void *boot_alloc(size_t size)
+{
+    void *p;
+
+    size = (size + 15) & ~(size_t)15;
+    if (size > BOOT_BYTES - boot_used)
+	return NULL;
+    p = boot_pool + boot_used;
+    boot_used += size;
+    return p;
+}
+
+/*
+ * is_boot - is p a block from the static pool?
+ */
+static int is_boot(void *p)
+{
+    return (char *)p >= boot_pool && (char *)p < boot_pool + BOOT_BYTES;
+}
+
+/*
+ * track - give the new block p of size bytes an id and record its
+ *     allocation, an op of the given type with the given alignment
+ */
+static void track(void *p, size_t size, int type, size_t align)
+{
+    int id;
+
+    if (!capturing || size > INT_MAX || align > INT_MAX)
+	return;
+    id = num_free_ids > 0 ? free_ids[--num_free_ids] : next_id++;
+    map_insert(p, size, id);
+    live_bytes += size;
+    if (live_bytes > peak_bytes)
+	peak_bytes = live_bytes;
+    record(type, id, (int)size, (int)align);
+}
+
+/*
+ * untrack - record the free of block p, if the trace knows it, and
+ *     return its id to the free id stack. Returns the id or -1.
+ */
+static int untrack(void *p)
+{
+    slot_t *s;
+    int id;
+    int *bigger;
+
+    if (!capturing || (s = lookup(p)) == NULL)
+	return -1;
+    id = s->id;
+    live_bytes -= s->size;
+    map_delete(s);
+
+    if (num_free_ids == max_free_ids) {
+	if ((bigger = pages(2 * max_free_ids * sizeof(int))) == NULL) {
+	    stop_capture();
+	    return id;
+	}
+	memcpy(bigger, free_ids, max_free_ids * sizeof(int));
+	munmap(free_ids, max_free_ids * sizeof(int));
+	free_ids = bigger;
+	max_free_ids *= 2;
+    }
+    free_ids[num_free_ids++] = id;
+    record(BINTRACE_FREE, id, 0, 0);
+    return id;
+}
+
+/*
+ * lookup - return the map slot of block p, or NULL if it is not there
+ */
+static slot_t *lookup(void *p)
+{
+    size_t mask = map_size - 1;
+    size_t i;
+
+    for (i = HASH(p, mask); map[i].ptr != NULL; i = (i + 1) & mask)
+	if (map[i].ptr == p)
+	    return &map[i];
+    return NULL;
+}
+
+/*
+ * map_insert - map block p of size bytes to id, keeping the map at 
+ *     most half full
+ */
+static void map_insert(void *p, size_t size, int id)
+{
+    size_t mask;
+    size_t i;
+
+    if (2 * (map_used + 1) > map_size)
+	map_grow();
+    if (!capturing)
+	return;
+    mask = map_size - 1;
+    for (i = HASH(p, mask); map[i].ptr != NULL; i = (i + 1) & mask)
+	;
+    map[i].ptr = p;
+    map[i].size = size;
+    map[i].id = id;
+    map_used++;
+}
+
+/*
+ * map_delete - empty slot s, moving later entries of its probe run
+ *     back so that lookups never need tombstones
+ */
+static void map_delete(slot_t *s)
+{
+    size_t mask = map_size - 1;
+    size_t i = s - map;
+    size_t j, home;
+
+    for (j = (i + 1) & mask; map[j].ptr != NULL; j = (j + 1) & mask) {
+	home = HASH(map[j].ptr, mask);
+	if (((j - home) & mask) >= ((j - i) & mask)) {
+	    map[i] = map[j];
+	    i = j;
+	}
+    }
+    map[i].ptr = NULL;
+    map_used--;
+}
+
+/*
+ * map_grow - double the number of slots in the pointer map
+ */
+static void map_grow(void)
+{
+    slot_t *old = map;
+    size_t old_size = map_size;
+    size_t i, j, mask;
+
+    if ((map = pages(2 * old_size * sizeof(slot_t))) == NULL) {
+	map = old;
+	stop_capture();
+	return;
+    }
+    map_size = 2 * old_size;
+    mask = map_size - 1;
+    for (i = 0; i < old_size; i++) {
+	if (old[i].ptr == NULL)
+	    continue;
+	for (j = HASH(old[i].ptr, mask); map[j].ptr != NULL; j = (j + 1) & mask)
+	    ;
+	map[j] = old[i];
+    }
+    munmap(old, old_size * sizeof(slot_t));
+}
+
+/*
+ * record - append an op record to the trace
+ */
+static void record(int type, int index, int size, int align)
+{
+    if (!capturing)
+	return;
+    buf[nbuf].type = type;
+    buf[nbuf].index = index;
+    buf[nbuf].size = size;
+    buf[nbuf].align = align;
+    num_ops++;
+    if (++nbuf == BUF_OPS)
+	flush_buf();
+}
+
+/*
+ * flush_buf - write the buffered records to the trace file
+ */
+static void flush_buf(void)
+{
+    char *p = (char *)buf;
+    size_t left = nbuf * sizeof(bintrace_op_t);
+    ssize_t n;
+
+    while (left > 0) {
+	if ((n = write(fd, p, left)) <= 0) {
+	    fprintf(stderr, "mmcapture: write error, trace is incomplete\n");
+	    stop_capture();
+	    return;
+	}
+	p += n;
+	left -= n;
+    }
+    nbuf = 0;
+}
+
+/*
+ * pages - get zeroed memory straight from the kernel
+ */
+static void *pages(size_t bytes)
+{
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return p == MAP_FAILED ? NULL : p;
+}
+
+/*
+ * stop_capture - close the trace file and stop recording
+ */
+static void stop_capture(void)
+{
+    capturing = 0;
+    if (fd >= 0)
+	close(fd);
+    fd = -1;
+}
+
+/*
+ * The fork handlers keep the lock consistent across fork. The parent
+ * holds it while forking, and the child, which cannot unlock a
+ * recursive mutex taken under the parent's thread id, gets a fresh
+ * one. The child shares the parent's trace file, so it stops
+ * capturing.
+ */
+static void atfork_prepare(void)
+{
+    pthread_mutex_lock(&lock);
+}
+
+static void atfork_parent(void)
+{
+    pthread_mutex_unlock(&lock);
+}
+
+static void atfork_child(void)
+{
+    pthread_mutex_t fresh = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+    lock = fresh;
+    capturing = 0;
+    if (fd >= 0)
+	close(fd);
+    fd = -1;
+}
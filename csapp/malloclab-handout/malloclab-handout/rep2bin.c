@@ -0,0 +1,133 @@
+/*
+ * rep2bin.c - Convert a text .rep trace into the binary trace format
+ *     described in bintrace.h, which mdriver can mmap instead of parse.
+ *
+ * usage: rep2bin <input.rep> <output file>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "bintrace.h"
+
+#define MAXLINE 1024
+
+static void app_error(char *msg);
+
+int main(int argc, char **argv)
+{
+    FILE *in, *out;
+    char line[MAXLINE], msg[MAXLINE];
+    char *p, *end;
+    bintrace_hdr_t hdr;
+    bintrace_op_t op;
+    int header[4];
+    int nhdr = 0;
+    int num_ops = 0;
+    int max_index = -1;
+    int lineno = 0;
+
+    if (argc != 3) {
+	fprintf(stderr, "usage: %s <input.rep> <output file>\n", argv[0]);
+	exit(1);
+    }
+    if ((in = fopen(argv[1], "r")) == NULL) {
+	fprintf(stderr, "Could not open %s: %s\n", argv[1], strerror(errno));
+	exit(1);
+    }
+    if ((out = fopen(argv[2], "w")) == NULL) {
+	fprintf(stderr, "Could not open %s: %s\n", argv[2], strerror(errno));
+	exit(1);
+    }
+
+    /* Leave room for the header, which is written once the ops are known */
+    memset(&hdr, 0, sizeof(hdr));
+    if (fwrite(&hdr, sizeof(hdr), 1, out) != 1)
+	app_error("write error");
+
+    while (fgets(line, MAXLINE, in) != NULL) {
+	lineno++;
+	p = line;
+	while (*p == ' ' || *p == '\t')
+	    p++;
+	if (*p == '\n' || *p == '\0')
+	    continue;
+
+	/* The first four numbers are the header fields */
+	if (nhdr < 4) {
+	    header[nhdr++] = strtol(p, &end, 10);
+	    if (end == p) {
+		sprintf(msg, "Bad header on line %d", lineno);
+		app_error(msg);
+	    }
+	    continue;
+	}
+
+	switch (*p) {
+	case 'a':
+	    op.type = BINTRACE_ALLOC;
+	    break;
+	case 'r':
+	    op.type = BINTRACE_REALLOC;
+	    break;
+	case 'f':
+	    op.type = BINTRACE_FREE;
+	    break;
+	case 'c':
+	    op.type = BINTRACE_CALLOC;
+	    break;
+	case 'm':
+	    op.type = BINTRACE_MEMALIGN;
+	    break;
+	default:
+	    sprintf(msg, "Bogus type character (%c) on line %d", *p, lineno);
+	    app_error(msg);
+	}
+	op.index = strtol(p + 1, &end, 10);
+	op.align = (op.type == BINTRACE_MEMALIGN) ? strtol(end, &end, 10) : 0;
+	op.size = (op.type == BINTRACE_FREE) ? 0 : strtol(end, &end, 10);
+	if (op.index < 0) {
+	    sprintf(msg, "Bad block id on line %d", lineno);
+	    app_error(msg);
+	}
+	if (op.type == BINTRACE_MEMALIGN && 
+	    (op.align <= 0 || (op.align & (op.align - 1)) != 0)) {
+	    sprintf(msg, "Bad alignment on line %d", lineno);
+	    app_error(msg);
+	}
+	if (op.index > max_index)
+	    max_index = op.index;
+	if (fwrite(&op, sizeof(op), 1, out) != 1)
+	    app_error("write error");
+	num_ops++;
+    }
+
+    if (nhdr < 4)
+	app_error("Trace header is incomplete");
+    if (num_ops != header[2] || max_index != header[1] - 1)
+	fprintf(stderr, "Warning: header says %d ids and %d ops, found %d and %d\n",
+		header[1], header[2], max_index + 1, num_ops);
+
+    hdr.magic = BINTRACE_MAGIC;
+    hdr.version = BINTRACE_VERSION;
+    hdr.sugg_heapsize = header[0];
+    hdr.num_ids = max_index + 1;
+    hdr.num_ops = num_ops;
+    hdr.weight = header[3];
+    if (fseek(out, 0, SEEK_SET) < 0 || fwrite(&hdr, sizeof(hdr), 1, out) != 1)
+	app_error("write error");
+    if (fclose(out) != 0)
+	app_error("write error");
+    fclose(in);
+    return 0;
+}
+
+/*
+ * app_error - Report an error and quit
+ */
+static void app_error(char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(1);
+}
@@ -0,0 +1,686 @@
+/*
+ * tracegen.c - Generate synthetic allocator traces for mdriver from
+ *     parameterized distributions. The same seed and phases always give
+ *     the same trace, so traces of any length can be regenerated instead
+ *     of stored.
+ *
+ *     usage: tracegen [-hb] [-s <seed>] -o <file> <phase> [<phase> ...]
+ *
+ *     The trace is written as a .rep text trace, or with -b in the
+ *     binary format of bintrace.h, which mdriver loads much faster.
+ *
+ *     The trace is a sequence of phases, so the workload can change
+ *     partway through. A phase is a comma-separated list of key=value
+ *     settings. Settings a phase leaves out keep their value from the
+ *     previous phase, or the default in the first one:
+ *
+ *       ops=<n>        requests in the phase (100000)
+ *       size=<dist>    request sizes in bytes (exp:64)
+ *       life=<dist>    how many requests a block lives (exp:1000)
+ *       realloc=<pct>  percent of requests that resize a live block (0)
+ *       calloc=<pct>   percent of new blocks allocated with calloc (0)
+ *       memalign=<pct> percent of new blocks allocated with memalign (0)
+ *       align=<n>      the alignment of those, a power of 2 (64)
+ *       grow=<how>     the new size of a resized block: add:<n>,
+ *                      mul:<f>, or rand for a fresh size (mul:1.5)
+ *       max=<n>        a block that would grow past this many bytes
+ *                      gets a fresh size instead (1048576)
+ *       batch=<n>      producer/consumer mode if nonzero: blocks are
+ *                      allocated in bursts until 2n are outstanding,
+ *                      then freed oldest first until n are left (0)
+ *       drain=<0|1>    free every live block when the phase ends (0)
+ *
+ *     A <dist> is fixed:<n>, uniform:<lo>:<hi>, exp:<mean>,
+ *     pow2:<lo>:<hi> (powers of two between lo and hi), or a histogram
+ *     hist:<v>=<w>/<v>=<w>/... that draws v with relative weight w.
+ *
+ *     Outside producer/consumer mode each new block draws a lifetime
+ *     and is freed that many requests later. A block keeps the free
+ *     discipline of the phase that allocated it. Blocks still live at
+ *     the end of the trace are freed, so the trace is balanced and has
+ *     a few more ops than the phases ask for. Freed block ids are
+ *     reused, which keeps num_ids close to the peak number of live
+ *     blocks. For example, 10M requests of mostly small, short-lived
+ *     blocks followed by a phase of large, growing ones:
+ *
+ *     unix> tracegen -b -o synth.bin \
+ *               ops=10000000,size=hist:16=60/32=25/64=10/4096=5 \
+ *               ops=2000000,size=uniform:1000:20000,realloc=20,life=exp:20000
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <math.h>
+
+#include "bintrace.h"
+
+#define MAXLINE  1024
+#define MAXHIST  64          /* most values in a hist: distribution */
+#define MAXSIZE  (1 << 30)   /* largest request size */
+
+/* A probability distribution over positive integers */
+typedef struct {
+    enum { FIXED, UNIFORM, EXP, POW2, HIST } kind;
+    double a, b;             /* parameters, depending on the kind */
+    int n;                   /* number of histogram values */
+    long val[MAXHIST];       /* histogram values... */
+    double cum[MAXHIST];     /* ...and their cumulative weights */
+} dist_t;
+
+/* The settings of one phase */
+typedef struct {
+    long ops;                /* requests in the phase */
+    dist_t size;             /* request sizes */
+    dist_t life;             /* block lifetimes, in requests */
+    double realloc;          /* fraction of requests that are reallocs */
+    double calloc;           /* fraction of new blocks that are calloced */
+    double memalign;         /* fraction of new blocks that are memaligned */
+    long align;              /* the alignment they ask for */
+    char grow;               /* realloc growth: 'a'dd, 'm'ul or 'r'and */
+    double grow_by;          /* the amount to add or multiply by */
+    long max;                /* largest size a realloc grows to */
+    long batch;              /* producer/consumer burst size, or 0 */
+    int drain;               /* free everything at the end of the phase */
+} phase_t;
+
+/* A live block waiting on the lifetime heap */
+typedef struct {
+    long death;              /* request number at which it is freed */
+    int id;
+} death_t;
+
+/* Global variables */
+static FILE *out;            /* the trace being written */
+static int binary = 0;       /* write the binary format (-b) */
+static unsigned long long rng_state;
+static long now;             /* number of requests generated so far */
+static long nallocs, nreallocs, nfrees;
+
+/* Per block id, indexed by id */
+static int *id_size;         /* current size of the block */
+static int *id_pos;          /* its position in live[] */
+static int num_ids, id_cap;
+static int *free_ids;        /* ids of freed blocks, for reuse */
+static int num_free_ids;
+
+/* The live blocks */
+static int *live;            /* ids of all live blocks, in any order */
+static int num_live, live_cap;
+static death_t *deaths;      /* min-heap of blocks by death */
+static int num_deaths, deaths_cap;
+static int *queue;           /* producer/consumer blocks, oldest first */
+static int q_head, q_len, q_cap;   /* ring buffer of q_cap ids */
+static int consuming;        /* the consumer is freeing a burst */
+static double live_bytes, peak_bytes;
+static int peak_blocks;
+
+/* Function prototypes */
+static void parse_phase(char *spec, phase_t *p);
+static void parse_dist(char *spec, dist_t *d);
+static long draw(dist_t *d);
+static double uniform(void);
+static unsigned long long rng(void);
+static void run_phase(phase_t *p);
+static int draw_size(phase_t *p);
+static int new_size(phase_t *p, int size);
+static int alloc_block(phase_t *p, int size);
+static void free_block(int id);
+static void realloc_block(phase_t *p);
+static void push_death(long death, int id);
+static int pop_death(void);
+static void enqueue(int id);
+static void emit(int type, int id, int size, int align);
+static void write_header(int num_ops);
+static void *grow(void *p, int *cap, int need, size_t elt);
+static void usage(void);
+static void app_error(char *msg);
+
+int main(int argc, char **argv)
+{
+    char *outfile = NULL;
+    unsigned long long seed = 1;
+    phase_t phase;
+    int c, i;
+
+    while ((c = getopt(argc, argv, "hbs:o:")) != EOF) {
+	switch (c) {
+	case 'b': /* Write the binary trace format */
+	    binary = 1;
+	    break;
+	case 's': /* Seed for the random number generator */
+	    seed = strtoull(optarg, NULL, 0);
+	    break;
+	case 'o': /* Trace file to write */
+	    outfile = optarg;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (outfile == NULL || optind == argc) {
+	usage();
+	exit(1);
+    }
+    if ((out = fopen(outfile, "w")) == NULL) {
+	fprintf(stderr, "Could not open %s: %s\n", outfile, strerror(errno));
+	exit(1);
+    }
+
+    /* Scramble the seed so that small seeds give unrelated streams */
+    rng_state = seed * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL;
+    if (rng_state == 0)
+	rng_state = 1;
+
+    /* The defaults, which the first phase starts from */
+    memset(&phase, 0, sizeof(phase));
+    phase.ops = 100000;
+    parse_dist("exp:64", &phase.size);
+    parse_dist("exp:1000", &phase.life);
+    phase.grow = 'm';
+    phase.grow_by = 1.5;
+    phase.max = 1 << 20;
+    phase.align = 64;
+
+    /* Leave room for the header, which is written once the ops are known */
+    write_header(0);
+    for (i = optind; i < argc; i++) {
+	parse_phase(argv[i], &phase);
+	run_phase(&phase);
+    }
+
+    /* Free whatever is still live so that the trace is balanced */
+    while (num_live > 0)
+	free_block(live[num_live - 1]);
+
+    if (now > INT_MAX)
+	app_error("The trace has more than INT_MAX ops");
+    write_header((int)now);
+    if (fclose(out) != 0)
+	app_error("write error");
+
+    printf("%s: %ld ops (%ld mallocs, %ld reallocs, %ld frees), %d ids, "
+	   "peak %d blocks and %.0f bytes live\n", outfile, now, nallocs,
+	   nreallocs, nfrees, num_ids, peak_blocks, peak_bytes);
+    exit(0);
+}
+
+/*
+ * parse_phase - Apply the key=value settings in spec to phase p
+ */
+static void parse_phase(char *spec, phase_t *p)
+{
+    char buf[MAXLINE], msg[MAXLINE];
+    char *key, *val, *next;
+
+    if (strlen(spec) >= MAXLINE)
+	app_error("Phase description is too long");
+    strcpy(buf, spec);
+    for (key = buf; key != NULL; key = next) {
+	if ((next = strchr(key, ',')) != NULL)
+	    *next++ = '\0';
+	if ((val = strchr(key, '=')) == NULL) {
+	    sprintf(msg, "Phase setting \"%s\" is not key=value", key);
+	    app_error(msg);
+	}
+	*val++ = '\0';
+
+	if (!strcmp(key, "ops"))
+	    p->ops = atol(val);
+	else if (!strcmp(key, "size"))
+	    parse_dist(val, &p->size);
+	else if (!strcmp(key, "life"))
+	    parse_dist(val, &p->life);
+	else if (!strcmp(key, "realloc"))
+	    p->realloc = atof(val) / 100;
+	else if (!strcmp(key, "calloc"))
+	    p->calloc = atof(val) / 100;
+	else if (!strcmp(key, "memalign"))
+	    p->memalign = atof(val) / 100;
+	else if (!strcmp(key, "align"))
+	    p->align = atol(val);
+	else if (!strcmp(key, "max"))
+	    p->max = atol(val);
+	else if (!strcmp(key, "batch"))
+	    p->batch = atol(val);
+	else if (!strcmp(key, "drain"))
+	    p->drain = atoi(val);
+	else if (!strcmp(key, "grow")) {
+	    if (!strncmp(val, "add:", 4) || !strncmp(val, "mul:", 4)) {
+		p->grow = val[0];
+		p->grow_by = atof(val + 4);
+	    }
+	    else if (!strcmp(val, "rand"))
+		p->grow = 'r';
+	    else {
+		sprintf(msg, "Unknown growth \"%s\"", val);
+		app_error(msg);
+	    }
+	}
+	else {
+	    sprintf(msg, "Unknown phase setting \"%s\"", key);
+	    app_error(msg);
+	}
+    }
+
+    if (p->ops < 0 || p->batch < 0 || p->realloc < 0 || p->realloc > 1 ||
+	p->calloc < 0 || p->memalign < 0 || p->calloc + p->memalign > 1 ||
+	p->align < 1 || p->align > MAXSIZE || (p->align & (p->align - 1)) ||
+	p->max < 1 || p->max > MAXSIZE)
+	app_error("Phase setting out of range");
+}
+
+/*
+ * parse_dist - Parse a distribution such as "exp:64" into d
+ */
+static void parse_dist(char *spec, dist_t *d)
+{
+    char msg[MAXLINE];
+    char *p, *end;
+    double total = 0;
+
+    memset(d, 0, sizeof(*d));
+    if (sscanf(spec, "fixed:%lf", &d->a) == 1)
+	d->kind = FIXED;
+    else if (sscanf(spec, "uniform:%lf:%lf", &d->a, &d->b) == 2)
+	d->kind = UNIFORM;
+    else if (sscanf(spec, "exp:%lf", &d->a) == 1)
+	d->kind = EXP;
+    else if (sscanf(spec, "pow2:%lf:%lf", &d->a, &d->b) == 2) {
+	d->kind = POW2;
+	d->a = ceil(log2(d->a));    /* the exponents of lo and hi */
+	d->b = floor(log2(d->b));
+    }
+    else if (!strncmp(spec, "hist:", 5)) {
+	d->kind = HIST;
+	for (p = spec + 5; *p != '\0'; p = end) {
+	    if (d->n == MAXHIST)
+		app_error("Too many histogram values");
+	    d->val[d->n] = strtol(p, &end, 10);
+	    if (*end != '=' || d->val[d->n] < 1)
+		break;
+	    total += strtod(end + 1, &end);
+	    d->cum[d->n++] = total;
+	    if (*end == '/')
+		end++;
+	    else if (*end != '\0')
+		break;
+	}
+	if (*p != '\0' || d->n == 0 || total <= 0) {
+	    sprintf(msg, "Bad histogram \"%s\"", spec);
+	    app_error(msg);
+	}
+    }
+    else {
+	sprintf(msg, "Unknown distribution \"%s\"", spec);
+	app_error(msg);
+    }
+
+    if (d->kind != HIST && (d->a < (d->kind == POW2 ? 0 : 1) ||
+			    ((d->kind == UNIFORM || d->kind == POW2) && d->b < d->a))) {
+	sprintf(msg, "Bad parameters in distribution \"%s\"", spec);
+	app_error(msg);
+    }
+}
+
+/*
+ * draw - Draw a positive integer from distribution d
+ */
+static long draw(dist_t *d)
+{
+    double u, x = 1;
+    int i;
+
+    switch (d->kind) {
+    case FIXED:
+	x = d->a;
+	break;
+    case UNIFORM:
+	x = d->a + floor(uniform() * (d->b - d->a + 1));
+	break;
+    case EXP:
+	x = ceil(-d->a * log(uniform()));
+	break;
+    case POW2:
+	x = ldexp(1, (int)(d->a + floor(uniform() * (d->b - d->a + 1))));
+	break;
+    case HIST:
+	u = uniform() * d->cum[d->n - 1];
+	for (i = 0; i < d->n - 1 && d->cum[i] < u; i++)
+	    ;
+	x = d->val[i];
+	break;
+    }
+    if (x < 1)
+	return 1;
+    return (x > LONG_MAX / 2) ? LONG_MAX / 2 : (long)x;
+}
+
+/*
+ * uniform - A random double in (0, 1]
+ */
+static double uniform(void)
+{
+    return ((rng() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * rng - xorshift64* generator, the same on every platform
+ */
+static unsigned long long rng(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+/*
+ * run_phase - Generate the requests of phase p
+ */
+static void run_phase(phase_t *p)
+{
+    long end = now + p->ops;
+    int id;
+
+    while (now < end) {
+	if (p->batch > 0) {
+	    /* Producer/consumer: bursts of mallocs, then of FIFO frees */
+	    if (num_live > 0 && uniform() <= p->realloc)
+		realloc_block(p);
+	    else if (consuming && q_len > p->batch) {
+		id = queue[q_head];
+		q_head = (q_head + 1) % q_cap;
+		q_len--;
+		free_block(id);
+	    }
+	    else {
+		consuming = 0;
+		enqueue(alloc_block(p, draw_size(p)));
+		if (q_len >= 2 * p->batch)
+		    consuming = 1;
+	    }
+	}
+	else {
+	    /* Each block is freed when its lifetime is up */
+	    if (num_deaths > 0 && deaths[0].death <= now)
+		free_block(pop_death());
+	    else if (num_live > 0 && uniform() <= p->realloc)
+		realloc_block(p);
+	    else {
+		id = alloc_block(p, draw_size(p));
+		push_death(now + draw(&p->life), id);
+	    }
+	}
+    }
+
+    if (p->drain) {
+	while (num_live > 0)
+	    free_block(live[num_live - 1]);
+	num_deaths = q_len = q_head = 0;
+	consuming = 0;
+    }
+}
+
+/*
+ * alloc_block - Emit a malloc, calloc or memalign of size bytes, as
+ *     phase p mixes them, and return the block's id. A phase that only
+ *     mallocs draws no random number to choose, so adding the choice
+ *     left the traces of older phase lists unchanged.
+ */
+static int alloc_block(phase_t *p, int size)
+{
+    double u;
+    int id;
+
+    if (num_free_ids > 0)
+	id = free_ids[--num_free_ids];
+    else {
+	id = num_ids++;
+	if (num_ids > id_cap) {
+	    id_size = grow(id_size, &id_cap, num_ids, sizeof(int));
+	    id_pos = realloc(id_pos, id_cap * sizeof(int));
+	    free_ids = realloc(free_ids, id_cap * sizeof(int));
+	    if (id_pos == NULL || free_ids == NULL)
+		app_error("Out of memory");
+	}
+    }
+    live = grow(live, &live_cap, num_live + 1, sizeof(int));
+    id_size[id] = size;
+    id_pos[id] = num_live;
+    live[num_live++] = id;
+
+    live_bytes += size;
+    if (live_bytes > peak_bytes)
+	peak_bytes = live_bytes;
+    if (num_live > peak_blocks)
+	peak_blocks = num_live;
+    nallocs++;
+    u = (p->calloc > 0 || p->memalign > 0) ? uniform() : 1;
+    if (u < p->calloc)
+	emit(BINTRACE_CALLOC, id, size, 0);
+    else if (u < p->calloc + p->memalign)
+	emit(BINTRACE_MEMALIGN, id, size, (int)p->align);
+    else
+	emit(BINTRACE_ALLOC, id, size, 0);
+    return id;
+}
+
+/*
+ * free_block - Emit a free of block id. The caller has already taken
+ *     it off the lifetime heap or the queue.
+ */
+static void free_block(int id)
+{
+    int pos = id_pos[id];
+
+    live[pos] = live[--num_live];
+    id_pos[live[pos]] = pos;
+    free_ids[num_free_ids++] = id;
+
+    live_bytes -= id_size[id];
+    nfrees++;
+    emit(BINTRACE_FREE, id, 0, 0);
+}
+
+/*
+ * realloc_block - Emit a realloc of a random live block to the size
+ *     that phase p's growth pattern gives it
+ */
+static void realloc_block(phase_t *p)
+{
+    int id = live[(int)(uniform() * num_live) % num_live];
+    int size = new_size(p, id_size[id]);
+
+    live_bytes += size - id_size[id];
+    if (live_bytes > peak_bytes)
+	peak_bytes = live_bytes;
+    id_size[id] = size;
+    nreallocs++;
+    emit(BINTRACE_REALLOC, id, size, 0);
+}
+
+/*
+ * draw_size - A request size from phase p's size distribution
+ */
+static int draw_size(phase_t *p)
+{
+    long size = draw(&p->size);
+
+    return (size > MAXSIZE) ? MAXSIZE : (int)size;
+}
+
+/*
+ * new_size - The size a block of size bytes is resized to
+ */
+static int new_size(phase_t *p, int size)
+{
+    double x;
+
+    if (p->grow == 'a')
+	x = size + p->grow_by;
+    else if (p->grow == 'm')
+	x = ceil(size * p->grow_by);
+    else
+	x = draw(&p->size);
+    if (x < 1 || x > p->max)
+	return draw_size(p);
+    return (int)x;
+}
+
+/*
+ * push_death - Add block id, which dies at request death, to the heap
+ */
+static void push_death(long death, int id)
+{
+    int i, parent;
+
+    deaths = grow(deaths, &deaths_cap, num_deaths + 1, sizeof(death_t));
+    for (i = num_deaths++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (deaths[parent].death <= death)
+	    break;
+	deaths[i] = deaths[parent];
+    }
+    deaths[i].death = death;
+    deaths[i].id = id;
+}
+
+/*
+ * pop_death - Remove the block that dies first from the heap and
+ *     return its id
+ */
+static int pop_death(void)
+{
+    int id = deaths[0].id;
+    death_t last = deaths[--num_deaths];
+    int i = 0, child;
+
+    while ((child = 2*i + 1) < num_deaths) {
+	if (child + 1 < num_deaths &&
+	    deaths[child + 1].death < deaths[child].death)
+	    child++;
+	if (last.death <= deaths[child].death)
+	    break;
+	deaths[i] = deaths[child];
+	i = child;
+    }
+    deaths[i] = last;
+    return id;
+}
+
+/*
+ * enqueue - Add block id to the tail of the producer/consumer queue
+ */
+static void enqueue(int id)
+{
+    int old_cap = q_cap;
+
+    if (q_len == q_cap) {
+	queue = grow(queue, &q_cap, q_len + 1, sizeof(int));
+	/* unwrap the ring: move the part before the head past the old end */
+	memcpy(queue + old_cap, queue, q_head * sizeof(int));
+    }
+    queue[(q_head + q_len++) % q_cap] = id;
+}
+
+/*
+ * emit - Write one op to the trace and count it
+ */
+static void emit(int type, int id, int size, int align)
+{
+    bintrace_op_t op;
+
+    if (binary) {
+	op.type = type;
+	op.index = id;
+	op.size = size;
+	op.align = align;
+	if (fwrite(&op, sizeof(op), 1, out) != 1)
+	    app_error("write error");
+    }
+    else if (type == BINTRACE_FREE)
+	fprintf(out, "f %d\n", id);
+    else if (type == BINTRACE_MEMALIGN)
+	fprintf(out, "m %d %d %d\n", id, align, size);
+    else
+	fprintf(out, "%c %d %d\n", (type == BINTRACE_ALLOC) ? 'a' : 
+		(type == BINTRACE_CALLOC) ? 'c' : 'r', id, size);
+    now++;
+}
+
+/*
+ * write_header - Write the trace header at the start of the file. The
+ *     text header is padded to a fixed width, so that the placeholder
+ *     written first can be overwritten in place at the end.
+ */
+static void write_header(int num_ops)
+{
+    bintrace_hdr_t hdr;
+    int sugg = (peak_bytes > INT_MAX) ? INT_MAX : (int)peak_bytes;
+
+    if (fseek(out, 0, SEEK_SET) < 0)
+	app_error("seek error");
+    if (binary) {
+	hdr.magic = BINTRACE_MAGIC;
+	hdr.version = BINTRACE_VERSION;
+	hdr.sugg_heapsize = sugg;
+	hdr.num_ids = num_ids;
+	hdr.num_ops = num_ops;
+	hdr.weight = 1;
+	if (fwrite(&hdr, sizeof(hdr), 1, out) != 1)
+	    app_error("write error");
+    }
+    else if (fprintf(out, "%-11d\n%-11d\n%-11d\n%-11d\n",
+		     sugg, num_ids, num_ops, 1) < 0)
+	app_error("write error");
+    if (fseek(out, 0, SEEK_END) < 0)
+	app_error("seek error");
+}
+
+/*
+ * grow - Make sure array p of *cap elements of elt bytes has room for
+ *     need elements, doubling it as needed
+ */
+static void *grow(void *p, int *cap, int need, size_t elt)
+{
+    if (need <= *cap)
+	return p;
+    while (*cap < need)
+	*cap = (*cap == 0) ? 1024 : 2 * *cap;
+    if ((p = realloc(p, *cap * elt)) == NULL)
+	app_error("Out of memory");
+    return p;
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracegen [-hb] [-s <seed>] -o <file> <phase> [<phase> ...]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b         Write the binary trace format.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-o <file>  Write the trace to <file>.\n");
+    fprintf(stderr, "\t-s <seed>  Seed the random number generator (default 1).\n");
+    fprintf(stderr, "A phase is a list of key=value settings such as\n");
+    fprintf(stderr, "\tops=100000,size=exp:64,life=exp:1000,realloc=0,grow=mul:1.5,\n");
+    fprintf(stderr, "\tmax=1048576,batch=0,drain=0,calloc=0,memalign=0,align=64\n");
+    fprintf(stderr, "See tracegen.c for the keys and distributions.\n");
+}
+
+/*
+ * app_error - Report an error and quit
+ */
+static void app_error(char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(1);
+}